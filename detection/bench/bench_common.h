@@ -0,0 +1,49 @@
+#ifndef BENCH_COMMON_H_INCLUDED
+#define BENCH_COMMON_H_INCLUDED
+
+#include <math.h>
+#include <time.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+* Helpers shared by the benchmarks (and by verify_modes for its time
+* budget) : the clock, and the synthetic image they run on.
+*/
+
+// Wall-clock time, in seconds
+inline double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+
+// Deterministic pseudo-random generator, the same on every platform : 24bit
+// integers, or numbers in [0,1)
+inline unsigned int next_random(unsigned int &state)
+{
+    state = state * 1103515245u + 12345u;
+    return state >> 8;
+}
+
+inline double next_uniform(unsigned int &state)
+{
+    return next_random(state) / 16777216.;
+}
+
+
+// Image of nx x ny pixels made of smooth patterns and noise, so that the
+// histograms have modes
+inline void make_image(size_t nx, size_t ny, std::vector<float> &im)
+{
+    unsigned int state(1);
+    im.resize(nx * ny);
+    for (size_t j(0); j < ny; j++)
+        for (size_t i(0); i < nx; i++)
+            im[j*nx+i] = 128 + 60 * sin(0.05 * i + 0.02 * j) * cos(0.03 * j)
+                + (next_random(state) % 32);
+}
+
+#endif // BENCH_COMMON_H_INCLUDED
@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+// End-to-end benchmark : throughput of the whole processing of a keypoint
+// (a contrario histogram and detection of the modes, Lowe's histogram and
+// detection of the peaks), as done by modes_detection, on a synthetic or PNG
+// image and a synthetic set of keypoints, with 1 to N threads. The call
+// syntax is
+//     bench_e2e [-i image.png | -s WxH] [-n n_keypoints] [-w random|grid|clustered]
+//               [-r rmin,rmax] [-d uniform|log] [-L n_bins] [-f flag_norm] [-g]
+//               [-t max_threads] [-j]
+// For each number of threads, one CSV line (or JSON object with -j) gives
+// the time, the number of keypoints per second, the percentiles of the time
+// per keypoint and the peak resident memory of the process so far. Built
+// with make ALLOC=1, it also gives the number of allocations per keypoint
+// (see src/instrument.h).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <vector>
+
+#include "instrument.h"
+#include "io_png.h"
+#include "keypoint.h"
+#include "modes_detection.h"
+#include "bench_common.h"
+
+using namespace std;
+
+#define EPSILON 1
+// Number of keypoints taken at once by a thread
+#define CHUNK 64
+
+#ifdef MODES_ALLOC_ACCOUNTING
+#define ALLOCS_COLUMN ",allocs_per_keypoint"
+#else
+#define ALLOCS_COLUMN ""
+#endif
+
+
+// n keypoints of the image : uniformly spread (random), on a regular grid
+// (grid), or gathered around 16 random centers (clustered). The scales are
+// drawn in [rmin,rmax], uniformly or with a uniform logarithm (log), as the
+// scales of a scale-space detector.
+static void make_keypoints(size_t n, size_t nx, size_t ny, const char *workload, int rmin, int rmax,
+                           bool log_scales, vector<Keypoint> &kps)
+{
+    unsigned int state(2);
+    kps.resize(n);
+
+    vector<double> cx(16), cy(16);
+    for (size_t c(0); c < cx.size(); c++) {
+        cx[c] = nx * next_uniform(state);
+        cy[c] = ny * next_uniform(state);
+    }
+    size_t side = (size_t) ceil(sqrt((double) n));
+
+    for (size_t k(0); k < n; k++) {
+        double x, y;
+        if (!strcmp(workload, "grid")) {
+            x = (k % side + 0.5) * nx / side;
+            y = (k / side + 0.5) * ny / side;
+        } else if (!strcmp(workload, "clustered")) {
+            // Gaussian spread (Box-Muller) of 1/32 of the image around a center
+            size_t c = (size_t) (cx.size() * next_uniform(state));
+            double u = max(next_uniform(state), 1e-12), v = next_uniform(state);
+            double d = sqrt(-2 * log(u));
+            x = cx[c] + d * cos(2 * M_PI * v) * nx / 32;
+            y = cy[c] + d * sin(2 * M_PI * v) * ny / 32;
+        } else {
+            x = nx * next_uniform(state);
+            y = ny * next_uniform(state);
+        }
+        double t = next_uniform(state);
+        double r = log_scales ? rmin * pow((double) rmax / rmin, t) : rmin + t * (rmax - rmin + 1);
+        kps[k].x = (int) min(max(x, 0.), nx - 1.);
+        kps[k].y = (int) min(max(y, 0.), ny - 1.);
+        kps[k].r = min((int) r, rmax);
+    }
+}
+
+
+// State shared by the threads of a run
+struct Run
+{
+    const float *im;
+    const float *norm;
+    const float *theta;
+    size_t nx;
+    size_t ny;
+    int L;
+    int flag_norm;
+    const vector<Keypoint> *kps;
+    const vector<size_t> *order;
+    vector<double> latency; // time of each keypoint, in seconds
+    size_t next; // first keypoint not taken yet
+    pthread_mutex_t mutex;
+};
+
+static void *worker(void *arg)
+{
+    Run *run = (Run *) arg;
+    KeypointResult res;
+    for (;;) {
+        pthread_mutex_lock(&run->mutex);
+        size_t i0 = run->next;
+        run->next = min(run->order->size(), i0 + CHUNK);
+        pthread_mutex_unlock(&run->mutex);
+        if (i0 >= run->order->size())
+            return NULL;
+
+        for (size_t i(i0); i < min(run->order->size(), i0 + CHUNK); i++) {
+            const Keypoint &kp = (*run->kps)[(*run->order)[i]];
+            double t0 = now();
+            if (run->norm)
+                detect_keypoint_field(run->norm, run->theta, run->nx, run->ny, run->nx, kp.x, kp.y, kp.r,
+                                      run->L, run->flag_norm, EPSILON, false, res);
+            else
+                detect_keypoint(run->im, run->nx, run->ny, run->nx, kp.x, kp.y, kp.r,
+                                run->L, run->flag_norm, EPSILON, false, res);
+            run->latency[i] = now() - t0;
+        }
+    }
+}
+
+
+// p-th percentile of the sorted values v
+static double percentile(const vector<double> &v, double p)
+{
+    if (v.empty())
+        return 0;
+    size_t k = (size_t) ceil(p / 100 * v.size());
+    return v[k ? k - 1 : 0];
+}
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-i image.png | -s WxH] [-n n_keypoints] [-w random|grid|clustered]\n"
+            "       [-r rmin,rmax] [-d uniform|log] [-L n_bins] [-f flag_norm] [-g]\n"
+            "       [-t max_threads] [-j]\n", name);
+}
+
+int main(int c, char *v[])
+{
+    const char *image_file = NULL;
+    size_t nx = 2048, ny = 2048, n = 5000;
+    const char *workload = "random";
+    int rmin = 2, rmax = 32, L = 36, flag_norm = 0, max_threads = 1;
+    bool log_scales = true, with_field = false, json = false;
+    int opt;
+    while ((opt = getopt(c, v, "i:s:n:w:r:d:L:f:gt:j")) != -1) {
+        switch (opt) {
+        case 'i':
+            image_file = optarg;
+            break;
+        case 's':
+            if (sscanf(optarg, "%lux%lu", (unsigned long *) &nx, (unsigned long *) &ny) != 2) {
+                usage(v[0]);
+                return 1;
+            }
+            break;
+        case 'n':
+            n = atol(optarg);
+            break;
+        case 'w':
+            workload = optarg;
+            break;
+        case 'r':
+            if (sscanf(optarg, "%d,%d", &rmin, &rmax) != 2) {
+                usage(v[0]);
+                return 1;
+            }
+            break;
+        case 'd':
+            log_scales = !strcmp(optarg, "log");
+            break;
+        case 'L':
+            L = atoi(optarg);
+            break;
+        case 'f':
+            flag_norm = atoi(optarg);
+            break;
+        case 'g':
+            with_field = true;
+            break;
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        case 'j':
+            json = true;
+            break;
+        default:
+            usage(v[0]);
+            return 1;
+        }
+    }
+    if (nx < 3 || ny < 3 || rmin < 1 || rmax < rmin || L < 2 || max_threads < 1
+        || (strcmp(workload, "random") && strcmp(workload, "grid") && strcmp(workload, "clustered"))) {
+        usage(v[0]);
+        return 1;
+    }
+
+    // Image and keypoints
+    vector<float> im;
+    if (image_file) {
+        float *data = read_png_f32_gray(image_file, &nx, &ny);
+        if (!data) {
+            fprintf(stderr, "unable to read image %s\n", image_file);
+            return 1;
+        }
+        im.assign(data, data + nx * ny);
+        free(data);
+    } else {
+        make_image(nx, ny, im);
+    }
+    vector<Keypoint> kps;
+    make_keypoints(n, nx, ny, workload, rmin, rmax, log_scales, kps);
+    vector<size_t> order;
+    keypoints_schedule(kps, 0, kps.size(), order);
+
+    if (json)
+        printf("[\n");
+    else
+        printf("threads,keypoints,seconds,keypoints_per_s,p50_us,p90_us,p99_us,max_us,peak_rss_kib%s\n",
+               ALLOCS_COLUMN);
+
+    for (int threads(1); threads <= max_threads; threads++) {
+        Run run;
+        run.im = &im[0];
+        run.norm = run.theta = NULL;
+        run.nx = nx;
+        run.ny = ny;
+        run.L = L;
+        run.flag_norm = flag_norm;
+        run.kps = &kps;
+        run.order = &order;
+        run.latency.assign(kps.size(), 0);
+        run.next = 0;
+        pthread_mutex_init(&run.mutex, NULL);
+
+        // The gradient field is part of the time of the run
+#ifdef MODES_ALLOC_ACCOUNTING
+        unsigned long long allocs0 = instrument_allocations();
+#endif
+        double t0 = now();
+        vector<float> norm, theta;
+        if (with_field) {
+            norm.resize(nx * ny);
+            theta.resize(nx * ny);
+            orientation_field(&im[0], nx, ny, nx, &norm[0], &theta[0]);
+            run.norm = &norm[0];
+            run.theta = &theta[0];
+        }
+        vector<pthread_t> tids(threads);
+        for (int k(0); k < threads; k++)
+            if (pthread_create(&tids[k], NULL, worker, &run) != 0) {
+                fprintf(stderr, "unable to create the threads\n");
+                return 1;
+            }
+        for (int k(0); k < threads; k++)
+            pthread_join(tids[k], NULL);
+        double t = now() - t0;
+        pthread_mutex_destroy(&run.mutex);
+#ifdef MODES_ALLOC_ACCOUNTING
+        double allocs = (double) (instrument_allocations() - allocs0) / max((size_t) 1, kps.size());
+#endif
+
+        sort(run.latency.begin(), run.latency.end());
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        double p50 = 1e6 * percentile(run.latency, 50), p90 = 1e6 * percentile(run.latency, 90);
+        double p99 = 1e6 * percentile(run.latency, 99), pmax = 1e6 * percentile(run.latency, 100);
+        if (json)
+            printf("%s  {\"threads\": %d, \"keypoints\": %lu, \"seconds\": %.6f, \"keypoints_per_s\": %.1f, "
+                   "\"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f, \"peak_rss_kib\": %ld",
+                   threads > 1 ? ",\n" : "", threads, (unsigned long) kps.size(), t, kps.size() / t,
+                   p50, p90, p99, pmax, (long) usage.ru_maxrss);
+        else
+            printf("%d,%lu,%.6f,%.1f,%.1f,%.1f,%.1f,%.1f,%ld", threads, (unsigned long) kps.size(), t,
+                   kps.size() / t, p50, p90, p99, pmax, (long) usage.ru_maxrss);
+#ifdef MODES_ALLOC_ACCOUNTING
+        printf(json ? ", \"allocs_per_keypoint\": %.3f" : ",%.3f", allocs);
+#endif
+        printf(json ? "}" : "\n");
+        fflush(stdout);
+    }
+    if (json)
+        printf("\n]\n");
+    return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+// Benchmark of the order in which the keypoints are processed : random
+// keypoints of a large synthetic image, processed in the order of the list
+// and in the order of keypoints_schedule(). The call syntax is
+//     bench_schedule [input|morton|both] [n_keypoints] [size]
+// The misses of the last level cache during each order are read from the
+// hardware counters (perf_event_open() on Linux, allowed with
+// /proc/sys/kernel/perf_event_paranoid <= 2) and printed next to the
+// throughput, or "n/a" if they are not available.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "keypoint.h"
+#include "bench_common.h"
+
+using namespace std;
+
+#define N_BINS 36
+#define EPSILON 1
+
+
+// Keypoints spread uniformly over the image, with scales in [2,20]
+static void make_keypoints(size_t n, size_t size, vector<Keypoint> &kps)
+{
+    unsigned int state(2);
+    kps.resize(n);
+    for (size_t k(0); k < n; k++) {
+        kps[k].x = next_random(state) % size;
+        kps[k].y = next_random(state) % size;
+        kps[k].r = 2 + next_random(state) % 19;
+    }
+}
+
+
+// Counter of the last level cache misses of the calling thread : the read
+// misses of the LLC, or the generic cache misses if the processor does not
+// count them. The count of an interval is scaled by the time the counter was
+// enabled over the time it actually counted during the interval, if it was
+// multiplexed with other events.
+struct LlcCounter
+{
+    int fd;
+
+    LlcCounter() : fd(-1)
+    {
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                      | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0) {
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+        if (fd < 0)
+            fprintf(stderr, "cache miss counter not available (%s)\n", strerror(errno));
+#endif
+    }
+
+    ~LlcCounter()
+    {
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+    // Reads the count and the times enabled and running at start(), so that
+    // stop() scales the counts of the interval only
+    void start()
+    {
+#ifdef __linux__
+        if (fd >= 0 && !sample(v0)) {
+            close(fd);
+            fd = -1;
+        }
+#endif
+    }
+
+    // Misses since start(), or -1 if they are not counted
+    double stop()
+    {
+#ifdef __linux__
+        unsigned long long v1[3];
+        if (fd < 0 || !sample(v1) || v1[2] <= v0[2])
+            return -1;
+        return (double) (v1[0] - v0[0]) * (v1[1] - v0[1]) / (v1[2] - v0[2]);
+#else
+        return -1;
+#endif
+    }
+
+private :
+#ifdef __linux__
+    unsigned long long v0[3]; // count, time enabled, time running
+
+    bool sample(unsigned long long *v)
+    {
+        return read(fd, v, 3 * sizeof(unsigned long long)) == (ssize_t) (3 * sizeof(unsigned long long));
+    }
+#endif
+};
+
+
+// Number of misses, or n/a
+static const char *format_misses(double misses, char *buffer, size_t size)
+{
+    if (misses < 0)
+        snprintf(buffer, size, "%12s", "n/a");
+    else
+        snprintf(buffer, size, "%12.0f", misses);
+    return buffer;
+}
+
+
+// Processing of the keypoints in the given order, returning the time spent,
+// the number of LLC misses and a checksum of the results
+static double run(const vector<float> &im, size_t size, const vector<Keypoint> &kps,
+                  const vector<size_t> &order, LlcCounter &llc, double &misses, double &checksum)
+{
+    KeypointResult res;
+    checksum = 0;
+    llc.start();
+    double t0 = now();
+    for (size_t i(0); i < order.size(); i++) {
+        const Keypoint &kp = kps[order[i]];
+        detect_keypoint(&im[0], size, size, size, kp.x, kp.y, kp.r, N_BINS, 0, EPSILON, false, res);
+        checksum += res.nb_pixels;
+        for (size_t m(0); m < res.modes.size(); m++)
+            checksum += res.modes[m].a * (double) order[i];
+    }
+    double t = now() - t0;
+    misses = llc.stop();
+    return t;
+}
+
+
+int main(int c, char *v[])
+{
+    const char *mode = c > 1 ? v[1] : "both";
+    size_t n = c > 2 ? atol(v[2]) : 5000;
+    size_t size = c > 3 ? atol(v[3]) : 8192;
+    bool input = !strcmp(mode, "input") || !strcmp(mode, "both");
+    bool morton = !strcmp(mode, "morton") || !strcmp(mode, "both");
+    if ((!input && !morton) || n == 0 || size == 0) {
+        fprintf(stderr, "usage: %s [input|morton|both] [n_keypoints] [size]\n", v[0]);
+        return 1;
+    }
+
+    vector<float> im;
+    vector<Keypoint> kps;
+    make_image(size, size, im);
+    make_keypoints(n, size, kps);
+
+    vector<size_t> order;
+    double checksum, misses;
+    char buffer[32];
+    LlcCounter llc;
+    printf("%lu keypoints, %lux%lu image\n", (unsigned long) n, (unsigned long) size, (unsigned long) size);
+    if (input) {
+        order.resize(n);
+        for (size_t k(0); k < n; k++)
+            order[k] = k;
+        double t = run(im, size, kps, order, llc, misses, checksum);
+        printf("input order  : %8.3f s, %10.0f keypoints/s, %s LLC misses, checksum %.0f\n",
+               t, n / t, format_misses(misses, buffer, sizeof(buffer)), checksum);
+    }
+    if (morton) {
+        double t0 = now();
+        keypoints_schedule(kps, 0, n, order);
+        double ts = now() - t0;
+        double t = run(im, size, kps, order, llc, misses, checksum);
+        printf("morton order : %8.3f s, %10.0f keypoints/s, %s LLC misses, checksum %.0f (schedule %.3f s)\n",
+               t, n / t, format_misses(misses, buffer, sizeof(buffer)), checksum, ts);
+    }
+    return 0;
+}
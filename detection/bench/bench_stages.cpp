@@ -0,0 +1,411 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+// Microbenchmarks of the stages of the detection : histo_orientation() for
+// each combination of flags and scales from 4 to 64, and histo_counts(), and
+// browse_intervals() (on a Histo and a CountHisto16), spread_gaps(),
+// discard_modes(), compute_orientation() and the whole max_modes_detection()
+// for L in {8,36,72,180,360} on synthetic histograms.
+// The call syntax is
+//     bench_stages [-j] [-t seconds]
+// The results are written on stdout in CSV (default) or JSON (-j), one
+// record per case with the mean time per call in nanoseconds. Each case is
+// repeated for at least 0.05 seconds (-t). Built with make ALLOC=1, the
+// records also give the number of allocations per call (see
+// src/instrument.h), which is 0 for the steps that do not allocate.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "CountHisto.h"
+#include "Histo.h"
+#include "instrument.h"
+#include "modes_detection.h"
+#include "bench_common.h"
+
+using namespace std;
+
+#define EPSILON 1
+// Number of samples of the synthetic histograms, about the number of pixels
+// of the disc of a keypoint of scale 18
+#define N_SAMPLES 1000
+#define IMAGE_SIZE 1024
+
+static const int bins[] = {8, 36, 72, 180, 360};
+static const int scales[] = {4, 8, 16, 32, 64};
+static const char *const kinds[] = {"uniform", "single-peak", "multi-modal", "gap-heavy"};
+
+// Keeps the results alive, so that the calls are not optimized out
+static volatile float sink;
+
+#ifdef MODES_ALLOC_ACCOUNTING
+// Allocations per call of the last measure, with its setup
+static double allocs_per_call;
+#define ALLOCS_COLUMN ",allocs_per_call"
+#else
+#define ALLOCS_COLUMN ""
+#endif
+
+
+// Mean time of f(), in nanoseconds, repeated for at least min_time seconds.
+// f.setup() is called before each call, and its time is subtracted.
+template <typename F>
+static double measure(F &f, double min_time, long &calls)
+{
+    for (calls = 1; ; calls *= 2) {
+#ifdef MODES_ALLOC_ACCOUNTING
+        unsigned long long allocs0 = instrument_allocations();
+#endif
+        double t0 = now();
+        for (long k(0); k < calls; k++)
+            f.setup();
+        double t1 = now();
+        for (long k(0); k < calls; k++) {
+            f.setup();
+            f();
+        }
+        double t2 = now();
+#ifdef MODES_ALLOC_ACCOUNTING
+        allocs_per_call = (double) (instrument_allocations() - allocs0) / calls;
+#endif
+        if (t2 - t1 >= min_time || calls >= (1L << 30))
+            return 1e9 * max(0., (t2 - t1) - (t1 - t0)) / calls;
+    }
+}
+
+
+// Output of the records in CSV or JSON
+struct Report
+{
+    bool json;
+    int n;
+
+    void begin()
+    {
+        n = 0;
+        if (json)
+            printf("[\n");
+        else
+            printf("benchmark,L,histogram,r,flag_norm,flag_gauss,calls,ns_per_call%s\n", ALLOCS_COLUMN);
+    }
+
+    // Integer fields < 0 and NULL strings are not applicable
+    void record(const char *name, int L, const char *kind, int r, int flag_norm, int flag_gauss,
+                long calls, double ns)
+    {
+        if (json) {
+            printf("%s  {\"benchmark\": \"%s\"", n ? ",\n" : "", name);
+            if (L >= 0)
+                printf(", \"L\": %d", L);
+            if (kind)
+                printf(", \"histogram\": \"%s\"", kind);
+            if (r >= 0)
+                printf(", \"r\": %d, \"flag_norm\": %d, \"flag_gauss\": %d", r, flag_norm, flag_gauss);
+            printf(", \"calls\": %ld, \"ns_per_call\": %.1f", calls, ns);
+#ifdef MODES_ALLOC_ACCOUNTING
+            printf(", \"allocs_per_call\": %.3f", allocs_per_call);
+#endif
+            printf("}");
+        } else {
+            printf("%s,", name);
+            if (L >= 0)
+                printf("%d", L);
+            printf(",%s,", kind ? kind : "");
+            if (r >= 0)
+                printf("%d,%d,%d", r, flag_norm, flag_gauss);
+            else
+                printf(",,");
+            printf(",%ld,%.1f", calls, ns);
+#ifdef MODES_ALLOC_ACCOUNTING
+            printf(",%.3f", allocs_per_call);
+#endif
+            printf("\n");
+        }
+        fflush(stdout);
+        n++;
+    }
+
+    void end()
+    {
+        if (json)
+            printf("\n]\n");
+    }
+};
+
+
+// Synthetic histogram of L bins and N_SAMPLES samples of the given kind
+static void make_histo(int L, int kind, vector<float> &h)
+{
+    h.assign(L, 0);
+    for (int i(0); i < L; i++) {
+        float d1 = (i - L / 3.) / (L / 24. + 0.5);
+        float d2 = (i - 2 * L / 3.) / (L / 24. + 0.5);
+        float d3 = (i - L / 10.) / (L / 36. + 0.5);
+        switch (kind) {
+        case 0: // uniform
+            h[i] = 1;
+            break;
+        case 1: // single-peak
+            h[i] = 0.05 + exp(-d1 * d1 / 2);
+            break;
+        case 2: // multi-modal
+            h[i] = 0.05 + exp(-d1 * d1 / 2) + 0.7 * exp(-d2 * d2 / 2) + 0.5 * exp(-d3 * d3 / 2);
+            break;
+        default: // gap-heavy : half of the circle empty, spikes elsewhere
+            h[i] = (i < L / 2) ? 0 : (i % 4 == 0 ? 4 : 0.2);
+        }
+    }
+    float sum(0);
+    for (int i(0); i < L; i++)
+        sum += h[i];
+    for (int i(0); i < L; i++)
+        h[i] = floor(h[i] * N_SAMPLES / sum + 0.5);
+}
+
+
+// The cases, as functors with a setup() and a call
+struct HistoCase
+{
+    const float *im;
+    int r, L, flag_norm, flag_gauss;
+    void setup() {}
+    void operator()()
+    {
+        Histo h = histo_orientation(im, IMAGE_SIZE, IMAGE_SIZE, IMAGE_SIZE, IMAGE_SIZE / 2, IMAGE_SIZE / 2,
+                                    r, L, flag_norm, flag_gauss);
+        sink = h.get_M();
+    }
+};
+
+struct CountsCase
+{
+    const float *im;
+    int r, L;
+    void setup() {}
+    void operator()()
+    {
+        CountHisto16 h = histo_counts<uint16_t>(im, IMAGE_SIZE, IMAGE_SIZE, IMAGE_SIZE, IMAGE_SIZE / 2,
+                                                IMAGE_SIZE / 2, r, L);
+        sink = h.get_M();
+    }
+};
+
+// L x L matrices of browse_intervals(), and their copies restored by setup()
+struct Matrices
+{
+    int L;
+    vector<int> iv, iv0;
+    vector<float> en;
+    vector<int*> iv_rows;
+    vector<float*> en_rows;
+
+    void init(int l)
+    {
+        L = l;
+        iv.assign(L * L, 0);
+        en.assign(L * L, 0);
+        iv_rows.resize(L);
+        en_rows.resize(L);
+        for (int a(0); a < L; a++) {
+            iv_rows[a] = &iv[a * L];
+            en_rows[a] = &en[a * L];
+        }
+    }
+    void save() { iv0 = iv; }
+    void restore() { memcpy(&iv[0], &iv0[0], iv.size() * sizeof(int)); }
+};
+
+struct BrowseCase
+{
+    Histo *h;
+    Matrices *m;
+    void setup() {}
+    void operator()()
+    {
+        browse_intervals(*h, EPSILON, &m->iv_rows[0], &m->en_rows[0]);
+        sink = m->en[0];
+    }
+};
+
+struct BrowseCountsCase
+{
+    CountHisto16 *h;
+    Matrices *m;
+    void setup() {}
+    void operator()()
+    {
+        browse_intervals(*h, EPSILON, &m->iv_rows[0], &m->en_rows[0]);
+        sink = m->en[0];
+    }
+};
+
+struct SpreadCase
+{
+    Matrices *m;
+    void setup() { m->restore(); }
+    void operator()()
+    {
+        spread_gaps(m->L, &m->iv_rows[0]);
+        sink = m->iv[0];
+    }
+};
+
+struct DiscardCase
+{
+    Matrices *m;
+    void setup() { m->restore(); }
+    void operator()()
+    {
+        discard_modes(m->L, &m->iv_rows[0], &m->en_rows[0]);
+        sink = m->iv[0];
+    }
+};
+
+struct OrientationCase
+{
+    Histo *h;
+    int a, b;
+    void setup() {}
+    void operator()()
+    {
+        sink = compute_orientation(*h, a, b);
+    }
+};
+
+struct ModesCase
+{
+    Histo *h;
+    void setup() {}
+    void operator()()
+    {
+        sink = max_modes_detection(*h, EPSILON).size();
+    }
+};
+
+
+int main(int c, char *v[])
+{
+    Report report;
+    report.json = false;
+    double min_time = 0.05;
+    int opt;
+    while ((opt = getopt(c, v, "jt:")) != -1) {
+        switch (opt) {
+        case 'j':
+            report.json = true;
+            break;
+        case 't':
+            min_time = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-j] [-t seconds]\n", v[0]);
+            return 1;
+        }
+    }
+
+    long calls;
+    double ns;
+    report.begin();
+
+    // Histograms of a keypoint at the center of the image
+    vector<float> im;
+    make_image(IMAGE_SIZE, IMAGE_SIZE, im);
+    for (size_t s(0); s < sizeof(scales) / sizeof(scales[0]); s++)
+        for (int flag_gauss(0); flag_gauss < 2; flag_gauss++)
+            for (int flag_norm(0); flag_norm < 2; flag_norm++) {
+                HistoCase hc = {&im[0], scales[s], 36, flag_norm, flag_gauss};
+                ns = measure(hc, min_time, calls);
+                report.record("histo_orientation", 36, NULL, scales[s], flag_norm, flag_gauss, calls, ns);
+            }
+    for (size_t s(0); s < sizeof(scales) / sizeof(scales[0]); s++) {
+        CountsCase cc = {&im[0], scales[s], 36};
+        ns = measure(cc, min_time, calls);
+        report.record("histo_counts", 36, NULL, scales[s], 0, 0, calls, ns);
+    }
+
+    // Steps of the a contrario detection
+    for (size_t l(0); l < sizeof(bins) / sizeof(bins[0]); l++) {
+        int L = bins[l];
+        for (int kind(0); kind < 4; kind++) {
+            vector<float> data;
+            make_histo(L, kind, data);
+            Histo h(L, &data[0]);
+            Matrices m;
+            m.init(L);
+
+            BrowseCase bc = {&h, &m};
+            ns = measure(bc, min_time, calls);
+            report.record("browse_intervals", L, kinds[kind], -1, 0, 0, calls, ns);
+
+            // The synthetic histograms are made of counts
+            vector<uint16_t> counts(data.begin(), data.end());
+            CountHisto16 hc(L, &counts[0]);
+            BrowseCountsCase bcc = {&hc, &m};
+            ns = measure(bcc, min_time, calls);
+            report.record("browse_intervals_u16", L, kinds[kind], -1, 0, 0, calls, ns);
+
+            m.save();
+            SpreadCase sc = {&m};
+            ns = measure(sc, min_time, calls);
+            report.record("spread_gaps", L, kinds[kind], -1, 0, 0, calls, ns);
+
+            m.save();
+            DiscardCase dc = {&m};
+            ns = measure(dc, min_time, calls);
+            report.record("discard_modes", L, kinds[kind], -1, 0, 0, calls, ns);
+
+            // Orientation of the first maximal mode, or of a quarter of the
+            // circle if there is none
+            vector<float> modes = max_modes_detection(h, EPSILON);
+            OrientationCase oc = {&h, 0, L / 4};
+            if (modes.size() >= 3) {
+                oc.a = (int) modes[0];
+                oc.b = (int) modes[1];
+            }
+            ns = measure(oc, min_time, calls);
+            report.record("compute_orientation", L, kinds[kind], -1, 0, 0, calls, ns);
+
+            ModesCase mc = {&h};
+            ns = measure(mc, min_time, calls);
+            report.record("max_modes_detection", L, kinds[kind], -1, 0, 0, calls, ns);
+        }
+    }
+
+    report.end();
+    return 0;
+}
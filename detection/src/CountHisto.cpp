@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+#include <math.h>
+
+#include "CountHisto.h"
+
+/**
+* Constructors
+*/
+template <typename C>
+CountHisto<C>::CountHisto() : m_L(0), m_N(1), m_M(0)
+{
+}
+
+template <typename C>
+CountHisto<C>::CountHisto(int L) : m_L(0), m_N(1), m_M(0)
+{
+    reset(L);
+}
+
+template <typename C>
+CountHisto<C>::CountHisto(int L, const C *data) : m_L(0), m_N(1), m_M(0)
+{
+    reset(L);
+    C *d = L > Histo::INLINE_BINS ? &m_heap[0] : m_inline;
+    for (int i=0; i<L; i++) {
+        d[i] = data[i];
+        m_M += data[i];
+    }
+}
+
+
+/**
+* Infos
+*/
+// Same as Histo::sum(), in integers
+template <typename C>
+int CountHisto<C>::sum(int a, int b) const
+{
+    const C *data = get_data();
+    unsigned int s(0);
+    if (a <= b) {
+        for (int i=a; i<=b; i++) {
+            s += data[i];
+        }
+    } else {
+        for (int i=a; i<m_L; i++) {
+            s += data[i];
+        }
+        for (int i=0; i<=b; i++) {
+            s += data[i];
+        }
+    }
+    return s;
+}
+
+// Same as Histo::angle() without parabola
+template <typename C>
+float CountHisto<C>::angle(int bin) const
+{
+    float x = bin;
+    return -M_PI + x*(2*M_PI/m_L);
+}
+
+
+/**
+* Modifications of the histo
+*/
+template <typename C>
+void CountHisto<C>::reset(int L)
+{
+    m_L = L;
+    m_N = L*(L-1)+1;
+    m_M = 0;
+    if (L > Histo::INLINE_BINS)
+        m_heap.assign(L, 0);
+    else
+        for (int i=0; i<L; i++) {
+            m_inline[i] = 0;
+        }
+}
+
+
+template class CountHisto<uint16_t>;
+template class CountHisto<uint32_t>;
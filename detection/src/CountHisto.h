@@ -0,0 +1,68 @@
+#ifndef COUNT_HISTO_H_INCLUDED
+#define COUNT_HISTO_H_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+
+#include "Histo.h"
+
+// Histogram of numbers of pixels, with 16 or 32 bit bins : the a contrario
+// histogram without weights (flag_norm = 0, without Gaussian window). Its
+// modes are the same as those of a Histo of the same values, computed
+// without any conversion of the counts to float. The counts of up to
+// Histo::INLINE_BINS bins are stored in the object itself.
+template <typename C>
+class CountHisto
+{
+public :
+
+    /**
+    * Constructors
+    */
+    CountHisto();
+    CountHisto(int L);
+    CountHisto(int L, const C *data);
+
+    /**
+    * Accessors
+    */
+    int get_L() const { return m_L; }
+    int get_N() const { return m_N; }
+    unsigned int get_M() const { return m_M; }
+    const C *get_data() const {
+        return m_L <= Histo::INLINE_BINS ? m_inline : &m_heap[0];
+    };
+    C operator[](int i) const {
+        return get_data()[Histo::good_modulus(i,m_L)];
+    };
+
+    /**
+    * Infos
+    */
+    int sum(int a, int b) const;
+    float angle(int bin) const;
+
+    /**
+    * Modifications of the histo
+    */
+    // The count of a bin must stay below the largest value of C
+    void incr(int bin) {
+        (m_L <= Histo::INLINE_BINS ? m_inline : &m_heap[0])[bin]++;
+        m_M++;
+    };
+    // Empty histogram of L bins
+    void reset(int L);
+
+private :
+
+    int m_L; // number of bins
+    int m_N; // L(L-1)+1
+    unsigned int m_M; // number of samples in the histogram
+    C m_inline[Histo::INLINE_BINS];
+    std::vector<C> m_heap; // counts of the histograms of more than INLINE_BINS bins
+};
+
+typedef CountHisto<uint16_t> CountHisto16;
+typedef CountHisto<uint32_t> CountHisto32;
+
+#endif // COUNT_HISTO_H_INCLUDED
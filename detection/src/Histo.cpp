@@ -32,8 +32,12 @@
  */
 
 #include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <iostream>
 #include <fstream>
+#include <new>
 using namespace std;
 
 #include "Histo.h"
@@ -41,23 +45,32 @@ using namespace std;
 /**
 * Constructors
 */
-Histo::Histo() : m_L(0), m_N(1), m_M(0), m_data(0)
+Histo::Histo() : m_L(0), m_N(1), m_M(0), m_data(inline_data()), m_capacity(INLINE_BINS)
 {
 }
 
-Histo::Histo(int L) : m_L(L), m_N(m_L*(m_L-1)+1), m_M(0), m_data(new float[L])
+Histo::Histo(int L) : m_L(0), m_N(1), m_M(0), m_data(inline_data()), m_capacity(INLINE_BINS)
 {
+    reset(L);
+}
+
+Histo::Histo(int L, const float *data) : m_L(0), m_N(1), m_M(0), m_data(inline_data()), m_capacity(INLINE_BINS)
+{
+    reset(L);
     for (int i=0; i<L; i++) {
-        m_data[i] = 0;
+        m_data[i] = data[i];
+        m_M += data[i];
     }
 }
 
-Histo::Histo(const Histo& h) : m_L(h.m_L), m_N(h.m_N), m_M(h.m_M), m_data(0)
+Histo::Histo(const Histo& h) : m_L(0), m_N(1), m_M(0), m_data(inline_data()), m_capacity(INLINE_BINS)
 {
-    if (m_L > 0) {
-        m_data = new float[m_L];
-        for (int i=0; i < m_L; i++) m_data[i] = h.m_data[i];
-    }
+    *this = h;
+}
+
+Histo::Histo(Histo&& h) noexcept : m_L(0), m_N(1), m_M(0), m_data(inline_data()), m_capacity(INLINE_BINS)
+{
+    *this = static_cast<Histo&&>(h);
 }
 
 
@@ -66,7 +79,81 @@ Histo::Histo(const Histo& h) : m_L(h.m_L), m_N(h.m_N), m_M(h.m_M), m_data(0)
 */
 Histo::~Histo()
 {
-    delete m_data;
+    release();
+}
+
+
+/**
+* Assignments
+*/
+Histo& Histo::operator= (const Histo& h)
+{
+    if (this != &h) {
+        reserve(h.m_L);
+        m_L = h.m_L;
+        m_N = h.m_N;
+        m_M = h.m_M;
+        memcpy(m_data, h.m_data, m_L * sizeof(float));
+    }
+    return *this;
+}
+
+// The allocated data are taken from h, the inline ones are copied
+Histo& Histo::operator= (Histo&& h) noexcept
+{
+    if (this == &h)
+        return *this;
+    if (h.m_capacity > INLINE_BINS) {
+        release();
+        m_L = h.m_L;
+        m_N = h.m_N;
+        m_M = h.m_M;
+        m_data = h.m_data;
+        m_capacity = h.m_capacity;
+        h.m_L = 0;
+        h.m_N = 1;
+        h.m_M = 0;
+        h.m_data = h.inline_data();
+        h.m_capacity = INLINE_BINS;
+    } else {
+        // No allocation : h.m_L <= INLINE_BINS <= m_capacity
+        m_L = h.m_L;
+        m_N = h.m_N;
+        m_M = h.m_M;
+        memcpy(m_data, h.m_data, m_L * sizeof(float));
+    }
+    return *this;
+}
+
+
+/**
+* Storage of the data
+*/
+float *Histo::inline_data()
+{
+    uintptr_t p = (uintptr_t) m_inline;
+    return (float *) ((p + ALIGNMENT - 1) & ~(uintptr_t) (ALIGNMENT - 1));
+}
+
+// Room for L bins, the previous data being lost if it is allocated
+void Histo::reserve(int L)
+{
+    if (L <= m_capacity)
+        return;
+    void *p;
+    if (posix_memalign(&p, ALIGNMENT, L * sizeof(float)))
+        throw bad_alloc();
+    release();
+    m_data = (float *) p;
+    m_capacity = L;
+}
+
+void Histo::release()
+{
+    if (m_capacity > INLINE_BINS)
+        free(m_data);
+    m_data = inline_data();
+    m_capacity = INLINE_BINS;
 }
 
 
@@ -185,6 +272,17 @@ void Histo::operator*= (float a)
     m_M *= a;
 }
 
+void Histo::reset(int L)
+{
+    reserve(L);
+    m_L = L;
+    m_N = L*(L-1)+1;
+    m_M = 0;
+    for (int i=0; i<L; i++) {
+        m_data[i] = 0;
+    }
+}
+
 /**
 * Static methods
 */
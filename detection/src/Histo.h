@@ -2,24 +2,37 @@
 #define HISTO_H_INCLUDED
 
 #include <string>
-using namespace std;
 
+// The data of up to INLINE_BINS bins are stored in the object itself, and
+// those of larger histograms are allocated. In both cases they are aligned
+// on ALIGNMENT bytes, for the vector loads.
 class Histo
 {
 public :
 
+    static const int INLINE_BINS = 128;
+    static const int ALIGNMENT = 64;
+
     /**
     * Constructors
     */
     Histo();
     Histo(int L);
+    Histo(int L, const float *data);
     Histo(const Histo& h); // Passage par rfrence constante
+    Histo(Histo&& h) noexcept; // h is left empty if its data were allocated
 
     /**
     * Destructor
     */
     ~Histo();
 
+    /**
+    * Assignments
+    */
+    Histo& operator= (const Histo& h);
+    Histo& operator= (Histo&& h) noexcept;
+
 
     /**
     * Accessors
@@ -38,13 +51,16 @@ public :
     int sum(int a, int b) const;
     float max() const;
     float angle(int bin, int flag_parabola = 0) const;
-    void print(string filename) const;
+    void print(std::string filename) const;
 
     /**
     * Modifications of the histo
     */
     void incr(int bin, float x = 1);
     void operator*= (float a);
+    // Empty histogram of L bins, without allocation if L is not larger
+    // than the bins already available
+    void reset(int L);
 
     /**
     * Static methods
@@ -53,10 +69,16 @@ public :
 
 private :
 
-    int const m_L; // number of bins
-    int const m_N; // L(L-1)+1
+    void reserve(int L);
+    void release();
+    float *inline_data();
+
+    int m_L; // number of bins
+    int m_N; // L(L-1)+1
     float m_M; // number of samples in the histogram
     float *m_data; // pointer to the array of data
+    int m_capacity; // number of bins of m_data, allocated if > INLINE_BINS
+    float m_inline[INLINE_BINS + ALIGNMENT / sizeof(float) - 1];
 };
 
 #endif // HISTO_H_INCLUDED
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+#include "keypoint.h"
+#include "column_store.h"
+
+using namespace std;
+
+#define COLUMN_MAGIC "MODESCOL"
+#define COLUMN_BUFFER_SIZE (1 << 16)
+
+// Order in which the columns are created by ColumnWriter::open()
+enum {
+    COL_X, COL_Y, COL_R, COL_NB_PIXELS, COL_MODE_START, COL_PEAK_START,
+    COL_MODE_A, COL_MODE_B, COL_MODE_ORIENTATION, COL_MODE_LOG_NFA,
+    COL_PEAK_BIN, COL_PEAK_ORIENTATION, COL_PEAK_RATIO
+};
+
+static uint32_t column_width(ColumnType type)
+{
+    return (type == COLUMN_UINT64) ? 8 : 4;
+}
+
+
+/**
+* Writer
+*/
+ColumnWriter::ColumnWriter() : m_L(0), m_n_modes(0), m_n_peaks(0)
+{
+}
+
+ColumnWriter::~ColumnWriter()
+{
+    close();
+}
+
+bool ColumnWriter::add_column(const char *name, ColumnType type)
+{
+    Column c;
+    c.info.name = name;
+    c.info.type = type;
+    c.info.width = column_width(type);
+    c.info.count = 0;
+    c.file = fopen((m_dir + "/" + name + ".col").c_str(), "wb");
+    if (!c.file)
+        return false;
+    setvbuf(c.file, NULL, _IOFBF, COLUMN_BUFFER_SIZE);
+    m_columns.push_back(c);
+    return true;
+}
+
+bool ColumnWriter::append(int c, const void *value)
+{
+    m_columns[c].info.count++;
+    return fwrite(value, m_columns[c].info.width, 1, m_columns[c].file) == 1;
+}
+
+bool ColumnWriter::open(const char *dirname, int L)
+{
+    close();
+    if (mkdir(dirname, 0777) != 0 && errno != EEXIST)
+        return false;
+
+    m_dir = dirname;
+    m_L = L;
+    m_n_modes = 0;
+    m_n_peaks = 0;
+
+    // The index of a previous store would describe the truncated columns
+    if (unlink((m_dir + "/index").c_str()) != 0 && errno != ENOENT)
+        return false;
+
+    bool ok = add_column("x", COLUMN_INT32)
+              && add_column("y", COLUMN_INT32)
+              && add_column("r", COLUMN_INT32)
+              && add_column("nb_pixels", COLUMN_INT32)
+              && add_column("mode_start", COLUMN_UINT64)
+              && add_column("peak_start", COLUMN_UINT64)
+              && add_column("mode_a", COLUMN_INT32)
+              && add_column("mode_b", COLUMN_INT32)
+              && add_column("mode_orientation", COLUMN_FLOAT32)
+              && add_column("mode_log_nfa", COLUMN_FLOAT32)
+              && add_column("peak_bin", COLUMN_INT32)
+              && add_column("peak_orientation", COLUMN_FLOAT32)
+              && add_column("peak_ratio", COLUMN_FLOAT32);
+
+    // The start columns have one more value than the number of keypoints
+    ok = ok && append(COL_MODE_START, &m_n_modes) && append(COL_PEAK_START, &m_n_peaks);
+    if (!ok)
+        close();
+    return ok;
+}
+
+bool ColumnWriter::write(const Keypoint &kp, const KeypointResult &res)
+{
+    if (m_columns.empty())
+        return false;
+
+    int32_t nb_pixels = res.nb_pixels;
+    bool ok = append(COL_X, &kp.x) && append(COL_Y, &kp.y) && append(COL_R, &kp.r)
+              && append(COL_NB_PIXELS, &nb_pixels);
+
+    for (size_t i(0); i < res.modes.size(); i++) {
+        ok = ok && append(COL_MODE_A, &res.modes[i].a)
+             && append(COL_MODE_B, &res.modes[i].b)
+             && append(COL_MODE_ORIENTATION, &res.modes[i].orientation)
+             && append(COL_MODE_LOG_NFA, &res.modes[i].log_nfa);
+    }
+    for (size_t i(0); i < res.peaks.size(); i++) {
+        ok = ok && append(COL_PEAK_BIN, &res.peaks[i].bin)
+             && append(COL_PEAK_ORIENTATION, &res.peaks[i].orientation)
+             && append(COL_PEAK_RATIO, &res.peaks[i].ratio);
+    }
+
+    m_n_modes += res.modes.size();
+    m_n_peaks += res.peaks.size();
+    return ok && append(COL_MODE_START, &m_n_modes) && append(COL_PEAK_START, &m_n_peaks);
+}
+
+bool ColumnWriter::write_index()
+{
+    FILE *f = fopen((m_dir + "/index").c_str(), "wb");
+    if (!f)
+        return false;
+
+    uint32_t header[4] = {COLUMN_STORE_VERSION, (uint32_t) m_L, (uint32_t) m_columns.size(), 0};
+    bool ok = fwrite(COLUMN_MAGIC, 1, 8, f) == 8 && fwrite(header, sizeof(uint32_t), 4, f) == 4;
+    for (size_t c(0); ok && c < m_columns.size(); c++) {
+        char name[COLUMN_NAME_SIZE] = {0};
+        strncpy(name, m_columns[c].info.name.c_str(), COLUMN_NAME_SIZE-1);
+        uint32_t type = m_columns[c].info.type;
+        ok = fwrite(name, 1, COLUMN_NAME_SIZE, f) == COLUMN_NAME_SIZE
+             && fwrite(&type, sizeof(uint32_t), 1, f) == 1
+             && fwrite(&m_columns[c].info.width, sizeof(uint32_t), 1, f) == 1
+             && fwrite(&m_columns[c].info.count, sizeof(uint64_t), 1, f) == 1;
+    }
+    return (fclose(f) == 0) && ok;
+}
+
+// The index is only written once all the columns are complete, so that a
+// store without index is known to be unfinished
+bool ColumnWriter::close()
+{
+    if (m_columns.empty())
+        return true;
+
+    bool ok = true;
+    for (size_t c(0); c < m_columns.size(); c++)
+        ok = (fclose(m_columns[c].file) == 0) && ok;
+    ok = ok && write_index();
+    m_columns.clear();
+    return ok;
+}
+
+
+/**
+* Reader
+*/
+ColumnReader::ColumnReader() : m_L(0)
+{
+}
+
+ColumnReader::~ColumnReader()
+{
+    close();
+}
+
+bool ColumnReader::open(const char *dirname)
+{
+    close();
+    m_dir = dirname;
+
+    FILE *f = fopen((m_dir + "/index").c_str(), "rb");
+    if (!f)
+        return false;
+
+    char magic[8];
+    uint32_t header[4];
+    bool ok = fread(magic, 1, 8, f) == 8 && memcmp(magic, COLUMN_MAGIC, 8) == 0
+              && fread(header, sizeof(uint32_t), 4, f) == 4
+              && header[0] == COLUMN_STORE_VERSION;
+
+    for (uint32_t c(0); ok && c < header[2]; c++) {
+        char name[COLUMN_NAME_SIZE];
+        uint32_t type;
+        ColumnInfo info;
+        ok = fread(name, 1, COLUMN_NAME_SIZE, f) == COLUMN_NAME_SIZE
+             && fread(&type, sizeof(uint32_t), 1, f) == 1
+             && fread(&info.width, sizeof(uint32_t), 1, f) == 1
+             && fread(&info.count, sizeof(uint64_t), 1, f) == 1;
+        name[COLUMN_NAME_SIZE-1] = 0;
+        info.name = name;
+        info.type = (ColumnType) type;
+        m_columns.push_back(info);
+    }
+    fclose(f);
+
+    if (!ok) {
+        close();
+        return false;
+    }
+    m_L = header[1];
+    return true;
+}
+
+void ColumnReader::close()
+{
+    for (size_t i(0); i < m_maps.size(); i++)
+        munmap(m_maps[i].first, m_maps[i].second);
+    m_maps.clear();
+    m_columns.clear();
+}
+
+const void *ColumnReader::map(const char *name, uint64_t *count)
+{
+    for (size_t c(0); c < m_columns.size(); c++) {
+        if (m_columns[c].name != name)
+            continue;
+
+        if (count)
+            *count = m_columns[c].count;
+        size_t size;
+        if (__builtin_mul_overflow(m_columns[c].count, m_columns[c].width, &size) || size == 0)
+            return NULL;
+
+        // A column shorter than the index says cannot be mapped : reading
+        // past its end would raise SIGBUS
+        int fd = ::open((m_dir + "/" + name + ".col").c_str(), O_RDONLY);
+        if (fd < 0)
+            return NULL;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (uint64_t) st.st_size < size) {
+            ::close(fd);
+            return NULL;
+        }
+        void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            return NULL;
+
+        m_maps.push_back(make_pair(p, size));
+        return p;
+    }
+    return NULL;
+}
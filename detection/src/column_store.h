@@ -0,0 +1,104 @@
+#ifndef COLUMN_STORE_H_INCLUDED
+#define COLUMN_STORE_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "keypoint.h"
+#include "result_io.h"
+
+/**
+* Columnar result store. The results are written in a directory with one
+* file per column, each file being a plain array of fixed-width values in
+* the native byte order, so that a single column can be memory-mapped and
+* used without parsing. The file "index" describes the store :
+*     char[8] magic "MODESCOL", uint32 version, uint32 n_bins,
+*     uint32 n_columns, uint32 reserved
+* followed by n_columns entries
+*     char[24] name, uint32 type, uint32 width, uint64 count
+*
+* Columns indexed by keypoint : x, y, r, nb_pixels (int32), and mode_start,
+* peak_start (uint64, n_keypoints+1 values) which give, for keypoint k, the
+* range [start[k], start[k+1]) of its rows in the mode and peak columns.
+* Columns indexed by mode : mode_a, mode_b (int32), mode_orientation,
+* mode_log_nfa (float). Columns indexed by peak : peak_bin (int32),
+* peak_orientation, peak_ratio (float).
+*/
+#define COLUMN_STORE_VERSION 1
+#define COLUMN_NAME_SIZE 24
+
+enum ColumnType {
+    COLUMN_INT32 = 1,
+    COLUMN_UINT64 = 2,
+    COLUMN_FLOAT32 = 3
+};
+
+struct ColumnInfo
+{
+    std::string name;
+    ColumnType type;
+    uint32_t width; // in bytes
+    uint64_t count;
+};
+
+class ColumnWriter : public ResultSink
+{
+public :
+    ColumnWriter();
+    ~ColumnWriter();
+
+    bool open(const char *dirname, int L);
+    bool write(const Keypoint &kp, const KeypointResult &res);
+    bool close();
+
+private :
+    ColumnWriter(const ColumnWriter&);
+    ColumnWriter& operator=(const ColumnWriter&);
+
+    struct Column
+    {
+        ColumnInfo info;
+        FILE *file;
+    };
+
+    bool add_column(const char *name, ColumnType type);
+    bool append(int c, const void *value);
+    bool write_index();
+
+    std::string m_dir;
+    int m_L;
+    uint64_t m_n_modes;
+    uint64_t m_n_peaks;
+    std::vector<Column> m_columns;
+};
+
+class ColumnReader
+{
+public :
+    ColumnReader();
+    ~ColumnReader();
+
+    bool open(const char *dirname);
+    void close();
+
+    int get_L() const { return m_L; }
+    const std::vector<ColumnInfo>& columns() const { return m_columns; }
+
+    // Memory-map the column name, or return NULL if it is empty or does not
+    // exist. The mapping stays valid until the reader is closed.
+    const void *map(const char *name, uint64_t *count = 0);
+
+private :
+    ColumnReader(const ColumnReader&);
+    ColumnReader& operator=(const ColumnReader&);
+
+    std::string m_dir;
+    int m_L;
+    std::vector<ColumnInfo> m_columns;
+    std::vector<std::pair<void*, size_t> > m_maps;
+};
+
+#endif // COLUMN_STORE_H_INCLUDED
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_dispatch.h"
+
+static const char *isa_names[N_ISAS] = {"sse2", "avx2", "avx512"};
+
+static const Kernels *isa_kernels[N_ISAS] = {&kernels_sse2, &kernels_avx2, &kernels_avx512};
+
+
+const char *isa_name(Isa isa)
+{
+    return isa_names[isa];
+}
+
+
+// Best instruction set of the processor, as told by CPUID (and the
+// operating system, which has to save the wide registers)
+static Isa best_isa()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        return ISA_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return ISA_AVX2;
+#endif
+    return ISA_SSE2;
+}
+
+
+static Isa select_isa()
+{
+    Isa best = best_isa();
+    const char *name = getenv("MODES_ISA");
+    if (!name || !*name)
+        return best;
+
+    for (int i(0); i < N_ISAS; i++)
+        if (strcmp(name, isa_names[i]) == 0) {
+            if (i <= best)
+                return (Isa) i;
+            fprintf(stderr, "MODES_ISA=%s is not supported by this processor, using %s\n",
+                    name, isa_names[best]);
+            return best;
+        }
+    fprintf(stderr, "unknown MODES_ISA=%s (sse2, avx2 or avx512), using %s\n", name, isa_names[best]);
+    return best;
+}
+
+
+Isa kernels_isa()
+{
+    static const Isa isa = select_isa();
+    return isa;
+}
+
+
+const Kernels &kernels()
+{
+    return *isa_kernels[kernels_isa()];
+}
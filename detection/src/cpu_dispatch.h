@@ -0,0 +1,56 @@
+#ifndef CPU_DISPATCH_H_INCLUDED
+#define CPU_DISPATCH_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Instruction sets for which the kernels of src/kernels.cpp are compiled
+enum Isa
+{
+    ISA_SSE2,
+    ISA_AVX2,
+    ISA_AVX512,
+    N_ISAS
+};
+
+// The hot loops, compiled in one binary for each instruction set by the
+// makefile. All the versions give exactly the same results.
+struct Kernels
+{
+    // Gradient (gx,gy) and its norm of the n pixels of the line l, whose
+    // lines above and below are up and down, as in histo_orientation() :
+    // l[-1] and l[n] are read
+    void (*gradient_f32)(const float *l, const float *up, const float *down, int n,
+                         float *gx, float *gy, float *norm);
+    void (*gradient_u8)(const unsigned char *l, const unsigned char *up, const unsigned char *down, int n,
+                        float *gx, float *gy, float *norm);
+
+    // Line a of the matrices of browse_intervals() for the histogram h of L
+    // bins and M samples : the entropy of the intervals [a,b] and their
+    // marker (2, -1 or 0). r and p are arrays of L floats for the kernel.
+    void (*intervals_row)(const float *h, int L, int M, float thresh, int a,
+                          int *intervals, float *entropy, float *r, float *p);
+    // Same for the counts of a CountHisto16 or a CountHisto32
+    void (*intervals_row_u16)(const uint16_t *h, int L, int M, float thresh, int a,
+                              int *intervals, float *entropy, float *r, float *p);
+    void (*intervals_row_u32)(const uint32_t *h, int L, int M, float thresh, int a,
+                              int *intervals, float *entropy, float *r, float *p);
+
+    // Gray conversion of a row of nx interleaved RGB pixels, as io_png
+    void (*gray_rgb_f32)(const unsigned char *rgb, size_t nx, float *out);
+    void (*gray_rgb_u8)(const unsigned char *rgb, size_t nx, unsigned char *out);
+};
+
+extern const Kernels kernels_sse2;
+extern const Kernels kernels_avx2;
+extern const Kernels kernels_avx512;
+
+// Kernels of the best instruction set supported by the processor, or of
+// the one named by the environment variable MODES_ISA (sse2, avx2 or
+// avx512) if it is supported, chosen at the first call
+const Kernels &kernels();
+Isa kernels_isa();
+
+const char *isa_name(Isa isa);
+
+#endif // CPU_DISPATCH_H_INCLUDED
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "io_png.h"
+#include "instrument.h"
+#include "modes_detection.h"
+#include "image_mmap.h"
+#include "image_cache.h"
+
+using namespace std;
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+ImageCache::ImageCache() : m_budget(0)
+{
+}
+
+bool ImageCache::open(const char *dir, size_t budget)
+{
+    struct stat st;
+    if (mkdir(dir, 0755) != 0 && (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)))
+        return false;
+    m_dir = dir;
+    m_budget = budget;
+    return true;
+}
+
+bool ImageCache::key(const char *fname, string &key) const
+{
+    FILE *f = fopen(fname, "rb");
+    if (!f)
+        return false;
+
+    uint64_t h = FNV_OFFSET;
+    vector<unsigned char> buffer(1 << 20);
+    size_t n;
+    while ((n = fread(&buffer[0], 1, buffer.size(), f)) > 0)
+        for (size_t i(0); i < n; i++)
+            h = (h ^ buffer[i]) * FNV_PRIME;
+    bool ok = !ferror(f);
+    fclose(f);
+
+    // Entries written by another version of the cache are never used
+    h = (h ^ IMAGE_CACHE_VERSION) * FNV_PRIME;
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) h);
+    key = hex;
+    return ok;
+}
+
+string ImageCache::path(const string &key, const char *ext) const
+{
+    return m_dir + "/" + key + ext;
+}
+
+
+// Write a raw float32 entry under a temporary name, then rename it
+bool ImageCache::store(const string &fname, const float *data, size_t nx, size_t ny)
+{
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".tmp%ld", (long) getpid());
+    string tmp = fname + suffix;
+    if (write_raw_f32(tmp.c_str(), data, nx, ny) && rename(tmp.c_str(), fname.c_str()) == 0)
+        return true;
+    unlink(tmp.c_str());
+    return false;
+}
+
+bool ImageCache::get_image(const string &key, const char *fname, MappedImage &im)
+{
+    string entry = path(key, ".f32");
+    if (im.open(entry.c_str())) {
+        utimes(entry.c_str(), NULL); // recently used
+        return true;
+    }
+
+    size_t nx, ny;
+    float *data;
+    {
+        MODES_STAGE(STAGE_DECODE);
+        data = read_png_f32_gray(fname, &nx, &ny);
+    }
+    if (!data)
+        return false;
+    bool ok = store(entry, data, nx, ny);
+    free(data);
+    return ok && im.open(entry.c_str());
+}
+
+bool ImageCache::get_field(const string &key, const MappedImage &im, MappedImage &field)
+{
+    string entry = path(key, ".field");
+    if (field.open(entry.c_str())) {
+        utimes(entry.c_str(), NULL);
+        return true;
+    }
+
+    // The planes have the stride of the image, which is a multiple of 16
+    // floats : it is stored as their width, and they keep this stride
+    size_t ny = im.get_ny(), stride = im.get_stride();
+    vector<float> planes(2 * stride * ny + 1);
+    orientation_field((const float *) im.get_data(), im.get_nx(), ny, stride,
+                      &planes[0], &planes[stride * ny]);
+    return store(entry, &planes[0], stride, 2 * ny) && field.open(entry.c_str());
+}
+
+
+// Temporary file of store() whose writer is gone : its process does not
+// exist anymore, or it has not written it for IMAGE_CACHE_TMP_AGE seconds
+static bool stale_tmp(const string &ext, const struct stat &st)
+{
+    long pid = atol(ext.c_str() + 4);
+    return (pid > 0 && kill(pid, 0) != 0 && errno == ESRCH)
+           || time(NULL) - st.st_mtime > IMAGE_CACHE_TMP_AGE;
+}
+
+// Remove the temporary files left by killed processes, then the least
+// recently used entries, until the cache fits in the budget. The temporary
+// files being written count in the budget.
+void ImageCache::evict()
+{
+    DIR *d = opendir(m_dir.c_str());
+    if (!d)
+        return;
+
+    vector<pair<time_t, string> > entries;
+    off_t total = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        string name = e->d_name;
+        struct stat st;
+        size_t dot = name.rfind('.');
+        if (dot == string::npos || stat((m_dir + "/" + name).c_str(), &st) != 0)
+            continue;
+        string ext = name.substr(dot);
+        if (ext.compare(0, 4, ".tmp") == 0) {
+            if (!stale_tmp(ext, st) || unlink((m_dir + "/" + name).c_str()) != 0)
+                total += st.st_size;
+            continue;
+        }
+        if (ext != ".f32" && ext != ".field")
+            continue;
+        entries.push_back(make_pair(st.st_mtime, name));
+        total += st.st_size;
+    }
+    closedir(d);
+
+    sort(entries.begin(), entries.end());
+    for (size_t k(0); k < entries.size() && total > (off_t) m_budget; k++) {
+        string fname = m_dir + "/" + entries[k].second;
+        struct stat st;
+        if (stat(fname.c_str(), &st) == 0 && unlink(fname.c_str()) == 0)
+            total -= st.st_size;
+    }
+}
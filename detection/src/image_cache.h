@@ -0,0 +1,51 @@
+#ifndef IMAGE_CACHE_H_INCLUDED
+#define IMAGE_CACHE_H_INCLUDED
+
+#include <stddef.h>
+#include <string>
+
+#include "image_mmap.h"
+
+/**
+* Directory of decoded images, to map them instead of decoding them again.
+* The entries are named after a hash (64bit FNV-1a) of the content of the
+* source file and of IMAGE_CACHE_VERSION :
+*     <hash>.f32    gray image, as a raw float32 image (see image_mmap.h)
+*     <hash>.field  gradient field (see orientation_field()), as a raw
+*                   float32 image of 2*ny lines of the stride of the gray
+*                   image : the norms then the angles
+* The entries are written to a temporary file <entry>.tmp<pid> then renamed,
+* hence several processes can share the directory. When the entries exceed
+* the size budget, the least recently used ones are removed, as well as the
+* temporary files of the processes that died while writing them.
+*/
+#define IMAGE_CACHE_VERSION 1
+// Seconds after which a temporary file that is not written anymore is removed
+#define IMAGE_CACHE_TMP_AGE 3600
+
+class ImageCache
+{
+public :
+    ImageCache();
+
+    bool open(const char *dir, size_t budget);
+
+    // Hash of the content of fname, used by the other methods
+    bool key(const char *fname, std::string &key) const;
+
+    // Map the gray image of fname, decoding it into the cache if needed
+    bool get_image(const std::string &key, const char *fname, MappedImage &im);
+    // Map the gradient field of the gray image im, computing it if needed
+    bool get_field(const std::string &key, const MappedImage &im, MappedImage &field);
+
+    void evict();
+
+private :
+    std::string path(const std::string &key, const char *ext) const;
+    bool store(const std::string &fname, const float *data, size_t nx, size_t ny);
+
+    std::string m_dir;
+    size_t m_budget;
+};
+
+#endif // IMAGE_CACHE_H_INCLUDED
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include "image_mmap.h"
+
+using namespace std;
+
+#define RAW_F32_MAGIC "MODESF32"
+
+/**
+* Constructor and destructor
+*/
+MappedImage::MappedImage() : m_map(0), m_size(0), m_data(0), m_type(PIXEL_U8),
+    m_nx(0), m_ny(0), m_stride(0)
+{
+}
+
+MappedImage::~MappedImage()
+{
+    close();
+}
+
+
+// Check the first bytes of fname to know if it is a PGM or raw float32 file
+bool MappedImage::is_mappable(const char *fname)
+{
+    char magic[8];
+    FILE *f = fopen(fname, "rb");
+    if (!f)
+        return false;
+    size_t n = fread(magic, 1, 8, f);
+    fclose(f);
+    return (n >= 2 && magic[0] == 'P' && magic[1] == '5')
+           || (n == 8 && memcmp(magic, RAW_F32_MAGIC, 8) == 0);
+}
+
+bool MappedImage::open(const char *fname)
+{
+    close();
+
+    int fd = ::open(fname, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 8) {
+        ::close(fd);
+        return false;
+    }
+
+    m_size = st.st_size;
+    m_map = mmap(NULL, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m_map == MAP_FAILED) {
+        m_map = 0;
+        return false;
+    }
+
+    ImageHeader h;
+    if (!parse_image_header((const char *) m_map, m_size, m_size, h)) {
+        close();
+        return false;
+    }
+    m_type = h.type;
+    m_nx = h.nx;
+    m_ny = h.ny;
+    m_stride = h.stride;
+    m_data = (const char *) m_map + h.offset;
+    return true;
+}
+
+void MappedImage::close()
+{
+    if (m_map)
+        munmap(m_map, m_size);
+    m_map = 0;
+    m_data = 0;
+    m_size = m_nx = m_ny = m_stride = 0;
+}
+
+
+// Header of a binary PGM file : "P5", width, height and maxval separated by
+// whitespaces (and possibly comments), then a single whitespace. The sizes
+// are int in the detection.
+static bool parse_pgm(const char *head, size_t len, size_t size, ImageHeader &h)
+{
+    const char *p = head;
+    const char *end = head + len;
+    if (len < 2 || p[0] != 'P' || p[1] != '5')
+        return false;
+    p += 2;
+
+    size_t values[3];
+    for (int k(0); k < 3; k++) {
+        while (p < end && (isspace(*p) || *p == '#')) {
+            if (*p == '#')
+                while (p < end && *p != '\n')
+                    p++;
+            else
+                p++;
+        }
+        if (p == end || !isdigit(*p))
+            return false;
+        values[k] = 0;
+        while (p < end && isdigit(*p)) {
+            values[k] = 10*values[k] + (*p++ - '0');
+            if (values[k] > INT_MAX)
+                return false;
+        }
+    }
+    if (p == end || !isspace(*p))
+        return false;
+    p++;
+
+    if (values[2] == 0 || values[2] > 65535)
+        return false;
+    h.type = (values[2] < 256) ? PIXEL_U8 : PIXEL_U16;
+    h.nx = h.stride = values[0];
+    h.ny = values[1];
+    h.offset = p - head;
+
+    size_t bytes;
+    return !__builtin_mul_overflow(h.nx * h.ny, pixel_size(h.type), &bytes)
+           && size - h.offset >= bytes;
+}
+
+static bool parse_raw_f32(const char *head, size_t len, size_t size, ImageHeader &h)
+{
+    if (len < RAW_F32_HEADER_SIZE)
+        return false;
+
+    uint32_t version, header_size;
+    uint64_t nx, ny, stride;
+    memcpy(&version, head + 8, 4);
+    memcpy(&header_size, head + 12, 4);
+    memcpy(&nx, head + 16, 8);
+    memcpy(&ny, head + 24, 8);
+    memcpy(&stride, head + 32, 8);
+    // The sizes of the images are int in the detection
+    uint64_t bytes;
+    if (version != RAW_F32_VERSION || header_size != RAW_F32_HEADER_SIZE
+        || nx > INT_MAX || ny > INT_MAX || stride < nx
+        || __builtin_mul_overflow(ny, stride, &bytes)
+        || __builtin_mul_overflow(bytes, sizeof(float), &bytes)
+        || __builtin_add_overflow(bytes, header_size, &bytes) || size < bytes)
+        return false;
+
+    h.type = PIXEL_F32;
+    h.nx = nx;
+    h.ny = ny;
+    h.stride = stride;
+    h.offset = header_size;
+    return true;
+}
+
+bool parse_image_header(const char *head, size_t len, size_t size, ImageHeader &h)
+{
+    if (len >= 8 && memcmp(head, RAW_F32_MAGIC, 8) == 0)
+        return parse_raw_f32(head, len, size, h);
+    return parse_pgm(head, len, size, h);
+}
+
+
+/**
+* Writers
+*/
+bool write_pgm(const char *fname, const unsigned char *data, size_t nx, size_t ny)
+{
+    FILE *f = fopen(fname, "wb");
+    if (!f)
+        return false;
+    bool ok = fprintf(f, "P5\n%lu %lu\n255\n", (unsigned long) nx, (unsigned long) ny) > 0
+              && fwrite(data, 1, nx * ny, f) == nx * ny;
+    return (fclose(f) == 0) && ok;
+}
+
+bool write_raw_f32(const char *fname, const float *data, size_t nx, size_t ny)
+{
+    // An image without pixels has no line to write
+    if (nx == 0 || ny == 0)
+        return false;
+    FILE *f = fopen(fname, "wb");
+    if (!f)
+        return false;
+
+    // Lines padded to 16 floats : every line is 64 bytes aligned in the
+    // mapped file, since the header is 64 bytes long
+    uint64_t header[3] = {nx, ny, (nx + 15) / 16 * 16};
+    uint32_t version[2] = {RAW_F32_VERSION, RAW_F32_HEADER_SIZE};
+    char padding[RAW_F32_HEADER_SIZE - 40] = {0};
+    bool ok = fwrite(RAW_F32_MAGIC, 1, 8, f) == 8
+              && fwrite(version, 4, 2, f) == 2
+              && fwrite(header, 8, 3, f) == 3
+              && fwrite(padding, 1, sizeof(padding), f) == sizeof(padding);
+
+    vector<float> line(header[2], 0.f);
+    for (size_t j(0); ok && j < ny; j++) {
+        memcpy(&line[0], data + j * nx, nx * sizeof(float));
+        ok = fwrite(&line[0], sizeof(float), line.size(), f) == line.size();
+    }
+    return (fclose(f) == 0) && ok;
+}
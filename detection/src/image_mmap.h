@@ -0,0 +1,78 @@
+#ifndef IMAGE_MMAP_H_INCLUDED
+#define IMAGE_MMAP_H_INCLUDED
+
+#include <stddef.h>
+
+/**
+* Memory-mapped gray images, used in place without any decoding :
+* - binary PGM files ("P5"), 8bit (maxval < 256) or 16bit big-endian
+* - raw float32 files, made of a 64 bytes header
+*       char[8] magic "MODESF32", uint32 version, uint32 header size (64),
+*       uint64 nx, ny, stride (in floats)
+*   followed by ny lines of stride floats, in the native byte order.
+*   write_raw_f32() pads the lines to a multiple of 64 bytes.
+*/
+#define RAW_F32_VERSION 1
+#define RAW_F32_HEADER_SIZE 64
+
+enum PixelType {
+    PIXEL_U8,  // unsigned char
+    PIXEL_U16, // be16
+    PIXEL_F32  // float
+};
+
+inline size_t pixel_size(PixelType type)
+{
+    return type == PIXEL_U8 ? 1 : (type == PIXEL_U16 ? 2 : 4);
+}
+
+/**
+* Layout of a PGM or raw float32 file : the ny lines of stride pixels start
+* offset bytes after the beginning of the file
+*/
+struct ImageHeader
+{
+    PixelType type;
+    size_t nx;
+    size_t ny;
+    size_t stride; // in pixels
+    size_t offset;
+};
+
+// Parse the first len bytes head of a file of size bytes
+bool parse_image_header(const char *head, size_t len, size_t size, ImageHeader &h);
+
+class MappedImage
+{
+public :
+    MappedImage();
+    ~MappedImage();
+
+    bool open(const char *fname);
+    void close();
+
+    PixelType get_type() const { return m_type; }
+    size_t get_nx() const { return m_nx; }
+    size_t get_ny() const { return m_ny; }
+    size_t get_stride() const { return m_stride; } // in pixels
+    const void *get_data() const { return m_data; }
+
+    static bool is_mappable(const char *fname);
+
+private :
+    MappedImage(const MappedImage&);
+    MappedImage& operator=(const MappedImage&);
+
+    void *m_map;
+    size_t m_size;
+    const void *m_data;
+    PixelType m_type;
+    size_t m_nx;
+    size_t m_ny;
+    size_t m_stride;
+};
+
+bool write_pgm(const char *fname, const unsigned char *data, size_t nx, size_t ny);
+bool write_raw_f32(const char *fname, const float *data, size_t nx, size_t ny);
+
+#endif // IMAGE_MMAP_H_INCLUDED
@@ -0,0 +1,547 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#ifdef MODES_INSTRUMENT
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#ifdef MODES_ALLOC_ACCOUNTING
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include "instrument.h"
+
+using namespace std;
+
+static const char *stage_names[N_STAGES] = {
+    "decode", "gradient", "histo", "browse", "spread", "discard", "keypoint"
+};
+
+static const char *counter_names[N_COUNTERS] = {
+    "pixels", "pixels_threshold", "intervals", "meaningful_intervals", "meaningful_gaps", "modes"
+};
+
+static const char *hw_names[N_HW] = {
+    "cycles", "instructions", "cache_misses", "branches", "branch_misses"
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+#define INSTRUMENT_UNIT "tsc"
+#else
+#define INSTRUMENT_UNIT "ns"
+#endif
+
+// The allocator is only replaced on glibc, which provides the functions
+// __libc_malloc()... to call the original one
+#if defined(MODES_ALLOC_ACCOUNTING) && defined(__GLIBC__)
+#define ALLOC_HOOKS
+#endif
+
+#ifdef ALLOC_HOOKS
+static const char *alloc_names[] = {
+    "allocs", "alloc_bytes", "frees", "heap_peak", "heap_growth"
+};
+#endif
+
+// Totals of every thread that ever ran an instrumented stage, kept after
+// the end of the thread
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static vector<InstrumentData*> registry;
+#ifdef ALLOC_HOOKS
+// Read by malloc() : the model of a library loaded with the program, whose
+// access never allocates
+static __thread InstrumentData *thread_data __attribute__((tls_model("initial-exec"))) = NULL;
+#else
+static __thread InstrumentData *thread_data = NULL;
+#endif
+
+static volatile sig_atomic_t dump_requested = 0;
+static int n_dumps = 0;
+
+// Hardware counters counted by at least one thread
+static bool hw_counted[N_HW];
+static bool perf_warned = false;
+// Key whose destructor closes the counters of an exiting thread
+static pthread_key_t perf_key;
+static pthread_once_t perf_key_once = PTHREAD_ONCE_INIT;
+
+
+static void on_sigusr1(int)
+{
+    dump_requested = 1;
+}
+
+
+static void dump_at_exit()
+{
+    instrument_dump();
+}
+
+
+// Open the hardware counters of the calling thread as one group, read at
+// once. Returns the error of the first counter that could not be opened,
+// or 0.
+static int open_perf(InstrumentData *d)
+{
+#ifdef __linux__
+    static const unsigned long long configs[N_HW] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    int error(0);
+    for (int k(0); k < N_HW; k++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[k];
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+                           | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // Without the kernel, to be allowed with perf_event_paranoid <= 2
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = syscall(__NR_perf_event_open, &attr, 0, -1, d->perf_fd, 0);
+        if (fd < 0) {
+            if (!error)
+                error = errno;
+            continue;
+        }
+        if (d->perf_fd < 0)
+            d->perf_fd = fd;
+        d->perf_fds[k] = fd;
+        d->perf_index[k] = d->n_perf++;
+    }
+    return error;
+#else
+    return ENOSYS;
+#endif
+}
+
+
+// Close the hardware counters of a thread when it exits; its totals stay in
+// the registry
+static void close_perf(void *data)
+{
+    InstrumentData *d = (InstrumentData *) data;
+    for (int k(0); k < N_HW; k++)
+        if (d->perf_fds[k] >= 0)
+            close(d->perf_fds[k]);
+    d->perf_fd = -1;
+}
+
+
+static void create_perf_key()
+{
+    pthread_key_create(&perf_key, close_perf);
+}
+
+
+InstrumentData *instrument_thread_data()
+{
+    if (thread_data)
+        return thread_data;
+
+    InstrumentData *d = new InstrumentData;
+    memset(d, 0, sizeof(InstrumentData));
+    d->perf_fd = -1;
+    for (int k(0); k < N_HW; k++)
+        d->perf_index[k] = d->perf_fds[k] = -1;
+    const char *perf = getenv("MODES_PERF");
+    int error(0);
+    if (perf && strcmp(perf, "0")) {
+        error = open_perf(d);
+        if (d->perf_fd >= 0) {
+            pthread_once(&perf_key_once, create_perf_key);
+            pthread_setspecific(perf_key, d);
+        }
+    }
+
+    pthread_mutex_lock(&registry_mutex);
+    for (int k(0); k < N_HW; k++)
+        hw_counted[k] = hw_counted[k] || d->perf_index[k] >= 0;
+    if (error && !perf_warned) {
+        fprintf(stderr, "hardware counters not available (%s), see /proc/sys/kernel/perf_event_paranoid\n",
+                strerror(error));
+        perf_warned = true;
+    }
+    if (registry.empty()) {
+        atexit(dump_at_exit);
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_sigusr1;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        sigaction(SIGUSR1, &sa, NULL);
+    }
+    registry.push_back(d);
+    pthread_mutex_unlock(&registry_mutex);
+
+    thread_data = d;
+    return d;
+}
+
+
+bool instrument_hw_read(unsigned long long *values, unsigned long long &enabled,
+                        unsigned long long &running)
+{
+    InstrumentData *d = instrument_thread_data();
+    if (d->perf_fd < 0)
+        return false;
+
+    // Number of counters, times enabled and running, then their values in
+    // the order of opening
+    unsigned long long group[3 + N_HW];
+    ssize_t n = read(d->perf_fd, group, sizeof(group));
+    if (n < (ssize_t) ((3 + d->n_perf) * sizeof(unsigned long long)))
+        return false;
+    enabled = group[1];
+    running = group[2];
+    for (int k(0); k < N_HW; k++)
+        values[k] = d->perf_index[k] >= 0 ? group[3 + d->perf_index[k]] : 0;
+    return true;
+}
+
+
+#ifdef ALLOC_HOOKS
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void *__libc_valloc(size_t size);
+void *__libc_pvalloc(size_t size);
+void __libc_free(void *p);
+}
+
+// Bytes in use by the process, and their largest value
+static long long heap_live = 0;
+static long long heap_max = 0;
+
+
+// Count the allocation of the block p (if not NULL) in the stages in
+// progress in the calling thread. The threads are only counted once
+// registered, and the allocations made to register them are not.
+static void count_alloc(void *p)
+{
+    if (!p)
+        return;
+    long long n = malloc_usable_size(p);
+    long long live = __sync_add_and_fetch(&heap_live, n);
+    long long m = heap_max;
+    while (live > m && !__sync_bool_compare_and_swap(&heap_max, m, live))
+        m = heap_max;
+
+    InstrumentData *d = thread_data;
+    if (!d)
+        return;
+    d->allocs_total++;
+    for (unsigned a = d->active; a; a &= a - 1) {
+        int stage = __builtin_ctz(a);
+        d->allocs[stage]++;
+        d->alloc_bytes[stage] += n;
+        if (live > d->heap_high[stage])
+            d->heap_high[stage] = live;
+    }
+}
+
+
+// Count the release of a block of n bytes
+static void count_free(long long n)
+{
+    __sync_sub_and_fetch(&heap_live, n);
+    InstrumentData *d = thread_data;
+    if (!d)
+        return;
+    for (unsigned a = d->active; a; a &= a - 1)
+        d->frees[__builtin_ctz(a)]++;
+}
+
+
+extern "C" void *malloc(size_t size) throw()
+{
+    void *p = __libc_malloc(size);
+    count_alloc(p);
+    return p;
+}
+
+
+extern "C" void *calloc(size_t n, size_t size) throw()
+{
+    void *p = __libc_calloc(n, size);
+    count_alloc(p);
+    return p;
+}
+
+
+// A free and an allocation, even if the block is not moved
+extern "C" void *realloc(void *p, size_t size) throw()
+{
+    long long n = p ? malloc_usable_size(p) : 0;
+    void *q = __libc_realloc(p, size);
+    if (!q && size)
+        return q; // p is unchanged
+    if (p)
+        count_free(n);
+    count_alloc(q);
+    return q;
+}
+
+
+extern "C" void free(void *p) throw()
+{
+    if (p)
+        count_free(malloc_usable_size(p));
+    __libc_free(p);
+}
+
+
+extern "C" void *memalign(size_t alignment, size_t size) throw()
+{
+    void *p = __libc_memalign(alignment, size);
+    count_alloc(p);
+    return p;
+}
+
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) throw()
+{
+    return memalign(alignment, size);
+}
+
+
+extern "C" int posix_memalign(void **p, size_t alignment, size_t size) throw()
+{
+    if (alignment % sizeof(void*) || alignment & (alignment - 1))
+        return EINVAL;
+    void *q = memalign(alignment, size);
+    if (!q)
+        return ENOMEM;
+    *p = q;
+    return 0;
+}
+
+
+extern "C" void *valloc(size_t size) throw()
+{
+    void *p = __libc_valloc(size);
+    count_alloc(p);
+    return p;
+}
+
+
+extern "C" void *pvalloc(size_t size) throw()
+{
+    void *p = __libc_pvalloc(size);
+    count_alloc(p);
+    return p;
+}
+
+
+long long instrument_heap_live()
+{
+    return heap_live;
+}
+
+#else
+
+long long instrument_heap_live()
+{
+    return 0;
+}
+
+#endif // ALLOC_HOOKS
+
+
+unsigned long long instrument_allocations()
+{
+    instrument_thread_data();
+    unsigned long long n(0);
+    pthread_mutex_lock(&registry_mutex);
+    for (size_t t(0); t < registry.size(); t++)
+        n += registry[t]->allocs_total;
+    pthread_mutex_unlock(&registry_mutex);
+    return n;
+}
+
+
+void instrument_poll()
+{
+    if (dump_requested) {
+        dump_requested = 0;
+        instrument_dump();
+    }
+}
+
+
+// Totals of one thread (or of all the threads) as one JSON object
+static void write_json(FILE *f, const InstrumentData &d)
+{
+    fprintf(f, "{\"stages\": {");
+    for (int s(0); s < N_STAGES; s++) {
+        fprintf(f, "%s\"%s\": {\"calls\": %llu, \"ticks\": %llu", s ? ", " : "",
+                stage_names[s], d.calls[s], d.ticks[s]);
+        for (int k(0); k < N_HW; k++)
+            if (hw_counted[k])
+                fprintf(f, ", \"%s\": %llu", hw_names[k], d.hw[s][k]);
+#ifdef ALLOC_HOOKS
+        fprintf(f, ", \"%s\": %llu, \"%s\": %llu, \"%s\": %llu, \"%s\": %lld, \"%s\": %lld",
+                alloc_names[0], d.allocs[s], alloc_names[1], d.alloc_bytes[s], alloc_names[2], d.frees[s],
+                alloc_names[3], d.heap_peak[s], alloc_names[4], d.heap_growth[s]);
+#endif
+        fprintf(f, "}");
+    }
+    fprintf(f, "}, \"counters\": {");
+    for (int c(0); c < N_COUNTERS; c++)
+        fprintf(f, "%s\"%s\": %llu", c ? ", " : "", counter_names[c], d.counts[c]);
+    fprintf(f, "}");
+#ifdef ALLOC_HOOKS
+    fprintf(f, ", \"allocs\": %llu", d.allocs_total);
+#endif
+    fprintf(f, "}");
+}
+
+
+// Same as CSV lines : dump,thread,kind,name,calls,value, the hardware
+// counters of a stage being named stage/counter
+static void write_csv(FILE *f, int dump, const char *thread, const InstrumentData &d)
+{
+    for (int s(0); s < N_STAGES; s++) {
+        fprintf(f, "%d,%s,stage,%s,%llu,%llu\n", dump, thread, stage_names[s], d.calls[s], d.ticks[s]);
+        for (int k(0); k < N_HW; k++)
+            if (hw_counted[k])
+                fprintf(f, "%d,%s,hw,%s/%s,%llu,%llu\n", dump, thread, stage_names[s], hw_names[k],
+                        d.calls[s], d.hw[s][k]);
+#ifdef ALLOC_HOOKS
+        long long values[] = {(long long) d.allocs[s], (long long) d.alloc_bytes[s], (long long) d.frees[s],
+                              d.heap_peak[s], d.heap_growth[s]};
+        for (int k(0); k < 5; k++)
+            fprintf(f, "%d,%s,alloc,%s/%s,%llu,%lld\n", dump, thread, stage_names[s], alloc_names[k],
+                    d.calls[s], values[k]);
+#endif
+    }
+    for (int c(0); c < N_COUNTERS; c++)
+        fprintf(f, "%d,%s,counter,%s,,%llu\n", dump, thread, counter_names[c], d.counts[c]);
+#ifdef ALLOC_HOOKS
+    fprintf(f, "%d,%s,alloc,allocs,,%llu\n", dump, thread, d.allocs_total);
+#endif
+}
+
+
+// The totals are read while the other threads may still update them : a
+// dump on signal is a snapshot, exact only at exit
+void instrument_dump()
+{
+    pthread_mutex_lock(&registry_mutex);
+
+    const char *format = getenv("MODES_INSTRUMENT_FORMAT");
+    bool csv = format && !strcmp(format, "csv");
+    const char *out = getenv("MODES_INSTRUMENT_OUT");
+    FILE *f = out ? fopen(out, "a") : stderr;
+    if (!f) {
+        fprintf(stderr, "cannot open %s\n", out);
+        pthread_mutex_unlock(&registry_mutex);
+        return;
+    }
+
+    InstrumentData total;
+    memset(&total, 0, sizeof(total));
+    for (size_t t(0); t < registry.size(); t++) {
+        for (int s(0); s < N_STAGES; s++) {
+            total.ticks[s] += registry[t]->ticks[s];
+            total.calls[s] += registry[t]->calls[s];
+            for (int k(0); k < N_HW; k++)
+                total.hw[s][k] += registry[t]->hw[s][k];
+            total.allocs[s] += registry[t]->allocs[s];
+            total.alloc_bytes[s] += registry[t]->alloc_bytes[s];
+            total.frees[s] += registry[t]->frees[s];
+            total.heap_peak[s] = max(total.heap_peak[s], registry[t]->heap_peak[s]);
+            total.heap_growth[s] = max(total.heap_growth[s], registry[t]->heap_growth[s]);
+        }
+        for (int c(0); c < N_COUNTERS; c++)
+            total.counts[c] += registry[t]->counts[c];
+        total.allocs_total += registry[t]->allocs_total;
+    }
+
+    // One JSON object per line and per dump, or CSV lines with a header
+    // before the first dump
+    if (csv) {
+        if (n_dumps == 0)
+            fprintf(f, "dump,thread,kind,name,calls,value\n");
+        for (size_t t(0); t < registry.size(); t++) {
+            char name[32];
+            snprintf(name, sizeof(name), "%u", (unsigned) t);
+            write_csv(f, n_dumps, name, *registry[t]);
+        }
+        write_csv(f, n_dumps, "total", total);
+#ifdef ALLOC_HOOKS
+        fprintf(f, "%d,total,alloc,process/heap_peak,,%lld\n", n_dumps, heap_max);
+#endif
+    } else {
+        fprintf(f, "{\"dump\": %d, \"unit\": \"%s\", \"threads\": [", n_dumps, INSTRUMENT_UNIT);
+        for (size_t t(0); t < registry.size(); t++) {
+            if (t)
+                fprintf(f, ", ");
+            write_json(f, *registry[t]);
+        }
+        fprintf(f, "], \"total\": ");
+        write_json(f, total);
+#ifdef ALLOC_HOOKS
+        // The allocations of the detection of a keypoint include those of
+        // its histograms
+        fprintf(f, ", \"heap_peak\": %lld, \"allocs_per_keypoint\": %.3f", heap_max,
+                total.calls[STAGE_KEYPOINT] ? (double) total.allocs[STAGE_KEYPOINT] / total.calls[STAGE_KEYPOINT] : 0.);
+#endif
+        fprintf(f, "}\n");
+    }
+    n_dumps++;
+
+    if (f != stderr)
+        fclose(f);
+    else
+        fflush(f);
+    pthread_mutex_unlock(&registry_mutex);
+}
+
+#endif // MODES_INSTRUMENT
@@ -0,0 +1,208 @@
+#ifndef INSTRUMENT_H_INCLUDED
+#define INSTRUMENT_H_INCLUDED
+
+// Instrumentation of the hot paths of the detection : the time spent in each
+// stage and the number of pixels, intervals and modes seen, accumulated by
+// each thread. It is only compiled with -DMODES_INSTRUMENT (make
+// INSTRUMENT=1); otherwise the macros below expand to nothing and the code
+// is the same as without them.
+//
+// The totals are written at the exit of the process, and when it receives
+// SIGUSR1 (by the next thread that ends a stage), as JSON or CSV according
+// to the environment variable MODES_INSTRUMENT_FORMAT (json by default),
+// in the file MODES_INSTRUMENT_OUT (standard error by default).
+//
+// With the environment variable MODES_PERF=1, the hardware counters of each
+// thread (cycles, instructions, cache misses, branches and mispredicted
+// branches) are also read at the beginning and the end of each stage, with
+// perf_event_open on Linux. The counters that cannot be opened (not
+// permitted, or not supported) are not reported, and the timings are the
+// same as without MODES_PERF.
+//
+// With -DMODES_ALLOC_ACCOUNTING as well (make ALLOC=1, which implies
+// INSTRUMENT), malloc, calloc, realloc, free and the aligned allocations
+// are replaced, on glibc, by functions that count the allocations and the
+// bytes allocated by each stage, and the bytes in use by the whole process : the
+// high-water mark reached during each stage and the largest growth during
+// one call are reported with the times. The operators new and delete of
+// libstdc++ call malloc and free, and are counted with them. The sizes are
+// those of malloc_usable_size(). This build replaces the allocator of the
+// whole process, and cannot be used with the address sanitizer.
+
+enum InstrumentStage
+{
+    STAGE_DECODE,   // decoding or reading of an image, band or window
+    STAGE_GRADIENT, // gradient field
+    STAGE_HISTO,    // histograms of orientation
+    STAGE_BROWSE,   // browse_intervals()
+    STAGE_SPREAD,   // spread_gaps()
+    STAGE_DISCARD,  // discard_modes()
+    STAGE_KEYPOINT, // whole detection of a keypoint, including the histograms
+    N_STAGES
+};
+
+enum InstrumentCounter
+{
+    COUNT_PIXELS,               // pixels of the discs of the histograms
+    COUNT_PIXELS_THRESHOLD,     // of which, without flag_norm, above 3*sqrt(2)
+    COUNT_INTERVALS,            // intervals [a,b] evaluated
+    COUNT_MEANINGFUL_INTERVALS, // of which meaningful intervals
+    COUNT_MEANINGFUL_GAPS,      // of which meaningful gaps
+    COUNT_MODES,                // maximal modes kept
+    N_COUNTERS
+};
+
+enum InstrumentHw
+{
+    HW_CYCLES,
+    HW_INSTRUCTIONS,
+    HW_CACHE_MISSES,
+    HW_BRANCHES,
+    HW_BRANCH_MISSES,
+    N_HW
+};
+
+#ifdef MODES_INSTRUMENT
+
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Totals of one thread. The times are in ticks of instrument_ticks(), and
+// include the nested stages (STAGE_KEYPOINT includes STAGE_HISTO...).
+struct InstrumentData
+{
+    unsigned long long ticks[N_STAGES];
+    unsigned long long calls[N_STAGES];
+    unsigned long long counts[N_COUNTERS];
+    unsigned long long hw[N_STAGES][N_HW];
+
+    // Group of the hardware counters of the thread, or -1, and position of
+    // each counter in the values read from the group, or -1. The counters
+    // are closed when the thread exits.
+    int perf_fd;
+    int perf_fds[N_HW];
+    int perf_index[N_HW];
+    int n_perf;
+
+    // Allocations and frees made during each stage, and bytes allocated,
+    // with MODES_ALLOC_ACCOUNTING. The bytes in use by the process are
+    // those of all the threads : heap_peak is the largest value reached
+    // during a stage, and heap_growth its largest increase during one call.
+    unsigned long long allocs[N_STAGES];
+    unsigned long long alloc_bytes[N_STAGES];
+    unsigned long long frees[N_STAGES];
+    long long heap_peak[N_STAGES];
+    long long heap_growth[N_STAGES];
+    // All the allocations of the thread, in a stage or not
+    unsigned long long allocs_total;
+
+    // Stages in progress (bit 1 << stage), and bytes in use at the
+    // beginning of each one and largest value since then
+    unsigned active;
+    long long heap_begin[N_STAGES];
+    long long heap_high[N_STAGES];
+};
+
+// Totals of the calling thread, registered on its first call
+InstrumentData *instrument_thread_data();
+
+// Read the hardware counters of the calling thread in values (0 for those
+// that are not counted), with the times the group was enabled and actually
+// counting : when the counters are multiplexed with other events, a count
+// over an interval is scaled by the ratio of these times. Returns false if
+// they are not read (no MODES_PERF, or no counter could be opened).
+bool instrument_hw_read(unsigned long long *values, unsigned long long &enabled,
+                        unsigned long long &running);
+
+// Write the totals if SIGUSR1 was received since the last call
+void instrument_poll();
+
+// Write the totals of each thread and of all the threads
+void instrument_dump();
+
+// Number of allocations made by all the threads since they were registered
+// (0 without MODES_ALLOC_ACCOUNTING), for the benchmarks
+unsigned long long instrument_allocations();
+
+// Bytes in use by the process (0 without MODES_ALLOC_ACCOUNTING)
+long long instrument_heap_live();
+
+// Time stamp counter on x86, nanoseconds elsewhere
+inline unsigned long long instrument_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec*1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// Adds the time between its construction and its destruction to a stage
+class InstrumentScope
+{
+    public:
+    explicit InstrumentScope(InstrumentStage stage) : m_stage(stage)
+    {
+#ifdef MODES_ALLOC_ACCOUNTING
+        InstrumentData *d = instrument_thread_data();
+        m_active = d->active;
+        d->active |= 1u << stage;
+        d->heap_begin[stage] = d->heap_high[stage] = instrument_heap_live();
+#endif
+        m_hw = instrument_hw_read(m_hw0, m_enabled0, m_running0);
+        m_t0 = instrument_ticks();
+    }
+    ~InstrumentScope()
+    {
+        unsigned long long t1 = instrument_ticks();
+        InstrumentData *d = instrument_thread_data();
+        d->ticks[m_stage] += t1 - m_t0;
+        d->calls[m_stage]++;
+        unsigned long long hw1[N_HW], enabled1, running1;
+        if (m_hw && instrument_hw_read(hw1, enabled1, running1) && running1 > m_running0) {
+            double scale = (double) (enabled1 - m_enabled0) / (running1 - m_running0);
+            for (int k(0); k < N_HW; k++)
+                d->hw[m_stage][k] += (unsigned long long) ((hw1[k] - m_hw0[k]) * scale + 0.5);
+        }
+#ifdef MODES_ALLOC_ACCOUNTING
+        d->active = m_active;
+        if (d->heap_high[m_stage] > d->heap_peak[m_stage])
+            d->heap_peak[m_stage] = d->heap_high[m_stage];
+        if (d->heap_high[m_stage] - d->heap_begin[m_stage] > d->heap_growth[m_stage])
+            d->heap_growth[m_stage] = d->heap_high[m_stage] - d->heap_begin[m_stage];
+#endif
+        instrument_poll();
+    }
+
+    private:
+    InstrumentStage m_stage;
+#ifdef MODES_ALLOC_ACCOUNTING
+    unsigned m_active;
+#endif
+    bool m_hw;
+    unsigned long long m_hw0[N_HW];
+    unsigned long long m_enabled0;
+    unsigned long long m_running0;
+    unsigned long long m_t0;
+};
+
+#define MODES_STAGE(stage) InstrumentScope instrument_scope_(stage)
+#define MODES_COUNT(counter, n) (instrument_thread_data()->counts[counter] += (n))
+// Counter local to a function, added to the totals with MODES_COUNT
+#define MODES_LOCAL_COUNTER(name) unsigned long long name = 0
+#define MODES_TALLY(name) (name++)
+
+#else
+
+#define MODES_STAGE(stage)
+#define MODES_COUNT(counter, n) ((void) 0)
+#define MODES_LOCAL_COUNTER(name)
+#define MODES_TALLY(name) ((void) 0)
+
+#endif
+
+#endif // INSTRUMENT_H_INCLUDED
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+// The kernels of cpu_dispatch.h. This file is compiled once per instruction
+// set, with -DKERNELS_ISA=sse2 -msse2, -DKERNELS_ISA=avx2 -mavx2... (see the
+// makefile), and the loops are vectorized by the compiler. The expressions
+// are the same as in modes_detection.cpp and io_png.cpp, and the floating
+// point operations are not contracted (-ffp-contract=off), so that every
+// version gives the same results.
+//
+// No inline function of a header may be used here : the linker could keep
+// its AVX version for the whole program.
+
+#include <math.h>
+
+#include "modes_detection.h"
+#include "cpu_dispatch.h"
+
+#define KERNELS_CONCAT(a, b) a ## _ ## b
+#define KERNELS_NAME(a, b) KERNELS_CONCAT(a, b)
+
+
+static void gradient_f32(const float *l, const float *up, const float *down, int n,
+                         float *gx, float *gy, float *norm)
+{
+    for (int i = 0; i < n; i++) {
+        float x = l[i+1]-l[i-1];
+        float y = -down[i]+up[i];
+        gx[i] = x;
+        gy[i] = y;
+        norm[i] = sqrtf(x*x+y*y);
+    }
+}
+
+
+static void gradient_u8(const unsigned char *l, const unsigned char *up, const unsigned char *down, int n,
+                        float *gx, float *gy, float *norm)
+{
+    for (int i = 0; i < n; i++) {
+        float x = (float) l[i+1]-(float) l[i-1];
+        float y = -(float) down[i]+(float) up[i];
+        gx[i] = x;
+        gy[i] = y;
+        norm[i] = sqrtf(x*x+y*y);
+    }
+}
+
+
+// Entropy and marker of the intervals [a,b] whose ratios k/M are r[b]. Only
+// the loops on p and on the markers are vectorized : compute_entropy() calls
+// the scalar log() of the C library in every version, since a vectorized
+// log would not round the same way.
+static void intervals_entropy(int L, float thresh, int a, int *intervals, float *entropy, float *r, float *p)
+{
+    for (int b = 0; b < L; b++)
+        p[b] = (1+b-a)/((float) L) + (b<a);
+
+    for (int b = 0; b < L; b++)
+        entropy[b] = compute_entropy(r[b],p[b]);
+
+    for (int b = 0; b < L; b++)
+        intervals[b] = entropy[b] > thresh ? (r[b] > p[b] ? 2 : -1) : 0;
+}
+
+
+// The number of samples k of the intervals [a,b] is accumulated along b,
+// with the additions of Histo::sum() in the same order, hence the same
+// values, in L steps instead of L*L/2
+static void intervals_row(const float *h, int L, int M, float thresh, int a,
+                          int *intervals, float *entropy, float *r, float *p)
+{
+    float s(0);
+    for (int b = a; b < L; b++) {
+        s += h[b];
+        r[b] = (float) (int) s/M;
+    }
+    for (int b = 0; b < a; b++) {
+        s += h[b];
+        r[b] = (float) (int) s/M;
+    }
+    intervals_entropy(L, thresh, a, intervals, entropy, r, p);
+}
+
+
+// Same with integer counts, whose sums are exact : the ratios are those of
+// intervals_row() on the same counts stored as floats
+template <typename C>
+static void intervals_row_counts(const C *h, int L, int M, float thresh, int a,
+                                 int *intervals, float *entropy, float *r, float *p)
+{
+    int s(0);
+    for (int b = a; b < L; b++) {
+        s += h[b];
+        r[b] = (float) s/M;
+    }
+    for (int b = 0; b < a; b++) {
+        s += h[b];
+        r[b] = (float) s/M;
+    }
+    intervals_entropy(L, thresh, a, intervals, entropy, r, p);
+}
+
+
+static void gray_rgb_f32(const unsigned char *rgb, size_t nx, float *out)
+{
+    for (size_t i = 0; i < nx; i++)
+        out[i] = (float) (6969 * rgb[3 * i] + 23434 * rgb[3 * i + 1]
+                          + 2365 * rgb[3 * i + 2]) / 32768;
+}
+
+
+static void gray_rgb_u8(const unsigned char *rgb, size_t nx, unsigned char *out)
+{
+    for (size_t i = 0; i < nx; i++)
+        out[i] = (unsigned char) ((6969 * rgb[3 * i] + 23434 * rgb[3 * i + 1]
+                                   + 2365 * rgb[3 * i + 2]) / 32768);
+}
+
+
+extern const Kernels KERNELS_NAME(kernels, KERNELS_ISA) = {
+    gradient_f32,
+    gradient_u8,
+    intervals_row,
+    intervals_row_counts<uint16_t>,
+    intervals_row_counts<uint32_t>,
+    gray_rgb_f32,
+    gray_rgb_u8
+};
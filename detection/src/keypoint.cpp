@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "CountHisto.h"
+#include "Histo.h"
+#include "instrument.h"
+#include "pixel.h"
+#include "modes_detection.h"
+#include "keypoint.h"
+
+using namespace std;
+
+
+// Copy the values of histogram h into the vector v
+static void save_histo(const Histo &h, vector<float> &v)
+{
+    v.assign(h.get_data(), h.get_data() + h.get_L());
+}
+
+template <typename C>
+static void save_histo(const CountHisto<C> &h, vector<float> &v)
+{
+    v.assign(h.get_data(), h.get_data() + h.get_L());
+}
+
+
+// The bins of the a contrario histogram of scale r count at most the
+// (2r+1)^2 pixels of its window : 16 bits are enough up to r = 127
+static bool counts_fit_16(int r)
+{
+    return (2LL*r+1)*(2LL*r+1) <= 65535;
+}
+
+
+// Half size of the square window of pixels read by detect_keypoint() around a
+// keypoint of scale r : the Gaussian window of Lowe's histogram has a radius
+// of 3*1.5*r, plus one pixel for the gradient
+int keypoint_support(int r)
+{
+    return (int) ceil(4.5*r) + 1;
+}
+
+
+// Range [c0,c1) of the coordinates, along the lines (x) or the columns (y)
+// of an image of size n, of the pixels read to process the keypoints kps
+static void keypoints_range(const vector<Keypoint> &kps, bool lines, size_t n, size_t &c0, size_t &c1)
+{
+    long cmin(n), cmax(-1);
+    for (size_t k(0); k < kps.size(); k++) {
+        int s = keypoint_support(kps[k].r);
+        long c = lines ? kps[k].y : kps[k].x;
+        cmin = min(cmin, c - s);
+        cmax = max(cmax, c + s);
+    }
+
+    long b1 = min((long) n, max(0L, cmax + 1));
+    long b0 = min(max(0L, cmin), b1);
+    c0 = b0;
+    c1 = b1;
+}
+
+
+// Band of lines [y0,y1) of an image with ny lines that contains all the pixels
+// read to process the keypoints kps. Processing a keypoint (x,y,r) on the
+// band only, with the keypoint (x,y-y0,r), gives the same results.
+void keypoints_rows(const vector<Keypoint> &kps, size_t ny, size_t &y0, size_t &y1)
+{
+    keypoints_range(kps, true, ny, y0, y1);
+}
+
+
+// Same for the band of columns [x0,x1) of an image with nx columns : the
+// keypoints are processed on the window [x0,x1)x[y0,y1) with (x-x0,y-y0,r).
+void keypoints_cols(const vector<Keypoint> &kps, size_t nx, size_t &x0, size_t &x1)
+{
+    keypoints_range(kps, false, nx, x0, x1);
+}
+
+
+// Window [wx0,wx1)x[wy0,wy1) of the pixels read to process the keypoints kps,
+// in absolute coordinates, bounded by the window of nx columns and ny lines
+// starting at (x0,y0)
+void keypoints_window(const vector<Keypoint> &kps, size_t x0, size_t y0, size_t nx, size_t ny,
+                      size_t &wx0, size_t &wy0, size_t &wx1, size_t &wy1)
+{
+    keypoints_cols(kps, x0 + nx, wx0, wx1);
+    keypoints_rows(kps, y0 + ny, wy0, wy1);
+    wx1 = max(wx1, x0);
+    wy1 = max(wy1, y0);
+    wx0 = min(max(wx0, x0), wx1);
+    wy0 = min(max(wy0, y0), wy1);
+}
+
+
+// Interleaving of the bits of the tile coordinates (tx,ty) : sorting the
+// tiles by this Z-order (Morton) code visits the image by squares of 2x2
+// tiles, then by squares of 4x4 tiles...
+static unsigned long long morton_code(unsigned int tx, unsigned int ty)
+{
+    unsigned long long code(0);
+    for (int b(0); b < 32; b++) {
+        code |= (unsigned long long) ((tx >> b) & 1) << (2*b);
+        code |= (unsigned long long) ((ty >> b) & 1) << (2*b+1);
+    }
+    return code;
+}
+
+
+// Sort key of a keypoint : the Morton code of the tile of its center, then
+// its scale, then its index to keep the sort stable
+struct ScheduleKey
+{
+    unsigned long long code;
+    int r;
+    size_t k;
+
+    bool operator<(const ScheduleKey &o) const
+    {
+        if (code != o.code)
+            return code < o.code;
+        if (r != o.r)
+            return r < o.r;
+        return k < o.k;
+    }
+};
+
+
+// Order in which to process the keypoints kps[k0..k1) so that consecutive
+// keypoints read close pixels : by tiles of SCHEDULE_TILE pixels along a
+// Z-order curve, and by scale inside a tile. order receives the indices of
+// the keypoints; the results have to be put back in the order of kps.
+void keypoints_schedule(const vector<Keypoint> &kps, size_t k0, size_t k1, vector<size_t> &order)
+{
+    vector<ScheduleKey> keys(k1 - k0);
+    for (size_t k(k0); k < k1; k++) {
+        ScheduleKey &key = keys[k - k0];
+        key.code = morton_code(max(kps[k].x, 0) / SCHEDULE_TILE, max(kps[k].y, 0) / SCHEDULE_TILE);
+        key.r = kps[k].r;
+        key.k = k;
+    }
+    sort(keys.begin(), keys.end());
+
+    order.resize(keys.size());
+    for (size_t i(0); i < keys.size(); i++)
+        order[i] = keys[i].k;
+}
+
+
+bool detect_scheduled(const vector<Keypoint> &kps, KeypointTask &task)
+{
+    vector<KeypointResult> results(min(kps.size(), (size_t) SCHEDULE_BATCH));
+    vector<size_t> order;
+    bool ok = true;
+    for (size_t k0(0); ok && k0 < kps.size(); k0 += SCHEDULE_BATCH) {
+        size_t k1 = min(kps.size(), k0 + SCHEDULE_BATCH);
+        keypoints_schedule(kps, k0, k1, order);
+        for (size_t i(0); i < order.size(); i++)
+            task.detect(kps[order[i]], results[order[i] - k0]);
+        for (size_t k(k0); ok && k < k1; k++)
+            ok = task.write(kps[k], results[k - k0]);
+    }
+    return ok;
+}
+
+
+// Histogram of the keypoint (x,y,r) : the table lut, if any, is only used
+// with 8bit images
+template <typename T>
+static Histo keypoint_histo(const T *im, int nx, int ny, size_t stride, int x, int y, int r,
+                            int L, int flag_norm, int flag_gauss, const OrientationLut *)
+{
+    return histo_orientation(im,nx,ny,stride,x,y,r,L,flag_norm,flag_gauss);
+}
+
+static Histo keypoint_histo(const unsigned char *im, int nx, int ny, size_t stride, int x, int y, int r,
+                            int L, int flag_norm, int flag_gauss, const OrientationLut *lut)
+{
+    if (lut && lut->get_L() == L)
+        return histo_orientation_lut(im,nx,ny,stride,x,y,r,*lut,flag_norm,flag_gauss);
+    return histo_orientation(im,nx,ny,stride,x,y,r,L,flag_norm,flag_gauss);
+}
+
+
+// Counts of the a contrario histogram of the keypoint (x,y,r) without
+// flag_norm, as keypoint_histo()
+template <typename C, typename T>
+static CountHisto<C> keypoint_counts(const T *im, int nx, int ny, size_t stride, int x, int y, int r,
+                                     int L, const OrientationLut *)
+{
+    return histo_counts<C>(im,nx,ny,stride,x,y,r,L);
+}
+
+template <typename C>
+static CountHisto<C> keypoint_counts(const unsigned char *im, int nx, int ny, size_t stride, int x, int y, int r,
+                                     int L, const OrientationLut *lut)
+{
+    if (lut && lut->get_L() == L)
+        return histo_counts_lut<C>(im,nx,ny,stride,x,y,r,*lut);
+    return histo_counts<C>(im,nx,ny,stride,x,y,r,L);
+}
+
+
+static void clear_result(KeypointResult &res)
+{
+    res.modes.clear();
+    res.peaks.clear();
+    res.histo_ac.clear();
+    res.histo_lowe.clear();
+}
+
+
+// Detection of the modes of the a contrario histogram h_ac (a Histo, or
+// a CountHisto without flag_norm) into res
+template <typename H>
+static void detect_modes(H &h_ac, float epsilon, bool keep_histos, KeypointResult &res)
+{
+    res.nb_pixels = (int) floor(h_ac.get_M() + 0.5);
+    if (keep_histos)
+        save_histo(h_ac, res.histo_ac);
+
+    vector<float> modes = max_modes_detection(h_ac,epsilon);
+    for (size_t i(0); 3*i+2 < modes.size(); i++) {
+        Mode m;
+        m.a = modes[3*i];
+        m.b = modes[3*i+1];
+        m.orientation = compute_orientation(h_ac,m.a,m.b);
+        m.log_nfa = modes[3*i+2];
+        res.modes.push_back(m);
+    }
+}
+
+
+// Detection of the peaks of Lowe's histogram h_lowe into res
+static void detect_peaks(Histo &h_lowe, int L, bool keep_histos, KeypointResult &res)
+{
+    if (keep_histos)
+        save_histo(h_lowe, res.histo_lowe);
+
+    float max_histo = h_lowe.max();
+    for (int i(0); i<L; i++)
+        if ((h_lowe[i] > 0.8*max_histo) && (h_lowe[i] > h_lowe[i-1]) && (h_lowe[i] > h_lowe[i+1])) {
+            Peak p;
+            p.bin = i;
+            p.orientation = h_lowe.angle(i,1);
+            p.ratio = h_lowe[i]/max_histo;
+            res.peaks.push_back(p);
+        }
+}
+
+
+// Function that runs the two orientation estimation methods on the keypoint
+// (x,y,r) of image im. The first step is the a contrario detection of modes on
+// the histogram built with flag_norm. The second step is Lowe's detection of
+// the local maxima higher than 80% of the global maximum, on the histogram
+// weighted by the gradient norm and a Gaussian window. The previous content
+// of res is overwritten, but its memory is reused. With a 8bit image, the
+// gradients are binned with the table lut if it is given for L bins.
+// Without flag_norm, the a contrario histogram is made of integer counts.
+template <typename T>
+void detect_keypoint(const T *im, int nx, int ny, size_t stride,
+                     int x, int y, int r, int L, int flag_norm, float epsilon,
+                     bool keep_histos, KeypointResult &res, const OrientationLut *lut)
+{
+    MODES_STAGE(STAGE_KEYPOINT);
+    clear_result(res);
+
+    // First step : A Contrario detection
+    if (flag_norm) {
+        Histo h_ac = keypoint_histo(im,nx,ny,stride,x,y,r,L,flag_norm,0,lut);
+        detect_modes(h_ac,epsilon,keep_histos,res);
+    } else if (counts_fit_16(r)) {
+        CountHisto16 h_ac = keypoint_counts<uint16_t>(im,nx,ny,stride,x,y,r,L,lut);
+        detect_modes(h_ac,epsilon,keep_histos,res);
+    } else {
+        CountHisto32 h_ac = keypoint_counts<uint32_t>(im,nx,ny,stride,x,y,r,L,lut);
+        detect_modes(h_ac,epsilon,keep_histos,res);
+    }
+
+    // Second step : Lowe's detection. For Lowe's peak detection, histogram
+    // has to be weighted with gradient norms
+    Histo h_lowe = keypoint_histo(im,nx,ny,stride,x,y,r,L,1,1,lut);
+    detect_peaks(h_lowe,L,keep_histos,res);
+}
+
+template void detect_keypoint(const float*, int, int, size_t, int, int, int, int, int, float, bool, KeypointResult&, const OrientationLut*);
+template void detect_keypoint(const unsigned char*, int, int, size_t, int, int, int, int, int, float, bool, KeypointResult&, const OrientationLut*);
+template void detect_keypoint(const be16*, int, int, size_t, int, int, int, int, int, float, bool, KeypointResult&, const OrientationLut*);
+
+
+// Same as detect_keypoint(), with the gradient field computed by
+// orientation_field() instead of the image
+void detect_keypoint_field(const float *norm, const float *theta, int nx, int ny, size_t stride,
+                           int x, int y, int r, int L, int flag_norm, float epsilon,
+                           bool keep_histos, KeypointResult &res)
+{
+    MODES_STAGE(STAGE_KEYPOINT);
+    clear_result(res);
+
+    if (flag_norm) {
+        Histo h_ac = histo_orientation_field(norm,theta,nx,ny,stride,x,y,r,L,flag_norm,0);
+        detect_modes(h_ac,epsilon,keep_histos,res);
+    } else if (counts_fit_16(r)) {
+        CountHisto16 h_ac = histo_counts_field<uint16_t>(norm,theta,nx,ny,stride,x,y,r,L);
+        detect_modes(h_ac,epsilon,keep_histos,res);
+    } else {
+        CountHisto32 h_ac = histo_counts_field<uint32_t>(norm,theta,nx,ny,stride,x,y,r,L);
+        detect_modes(h_ac,epsilon,keep_histos,res);
+    }
+
+    Histo h_lowe = histo_orientation_field(norm,theta,nx,ny,stride,x,y,r,L,1,1);
+    detect_peaks(h_lowe,L,keep_histos,res);
+}
@@ -0,0 +1,95 @@
+#ifndef KEYPOINT_H_INCLUDED
+#define KEYPOINT_H_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+
+#include "orientation_lut.h"
+
+/**
+* A keypoint (x,y) at scale r
+*/
+struct Keypoint
+{
+    int x;
+    int y;
+    int r;
+};
+
+/**
+* A mode [a,b] detected with the a contrario algorithm, with its orientation
+* (in radians) and its meaningfullness (-log(NFA))
+*/
+struct Mode
+{
+    int a;
+    int b;
+    float orientation;
+    float log_nfa;
+};
+
+/**
+* A local maximum of the histogram detected with Lowe's approach, with its
+* orientation (in radians) and the ratio between this maximum and the global one
+*/
+struct Peak
+{
+    int bin;
+    float orientation;
+    float ratio;
+};
+
+/**
+* Everything computed for one keypoint (x,y,r)
+*/
+struct KeypointResult
+{
+    int nb_pixels; // pixels that contributed to the a contrario histogram
+    std::vector<Mode> modes;
+    std::vector<Peak> peaks;
+    std::vector<float> histo_ac; // only filled if keep_histos is set
+    std::vector<float> histo_lowe;
+};
+
+int keypoint_support(int r);
+void keypoints_rows(const std::vector<Keypoint> &kps, size_t ny, size_t &y0, size_t &y1);
+void keypoints_cols(const std::vector<Keypoint> &kps, size_t nx, size_t &x0, size_t &x1);
+void keypoints_window(const std::vector<Keypoint> &kps, size_t x0, size_t y0, size_t nx, size_t ny,
+                      size_t &wx0, size_t &wy0, size_t &wx1, size_t &wy1);
+
+// Side, in pixels, of the squares of the image that keypoints_schedule()
+// visits one after the other
+#define SCHEDULE_TILE 64
+// Number of keypoints scheduled together, whose results are kept until they
+// can be written in the original order
+#define SCHEDULE_BATCH 65536
+void keypoints_schedule(const std::vector<Keypoint> &kps, size_t k0, size_t k1, std::vector<size_t> &order);
+
+/**
+* Detection of a set of keypoints with detect_scheduled() : detect() computes
+* the result of one keypoint, write() receives the results
+*/
+class KeypointTask
+{
+public :
+    virtual ~KeypointTask() {}
+    virtual void detect(const Keypoint &kp, KeypointResult &res) = 0;
+    virtual bool write(const Keypoint &kp, const KeypointResult &res) = 0;
+};
+
+// Detection of the keypoints kps by batches of SCHEDULE_BATCH, in the order
+// of keypoints_schedule(). The results of a batch are written in the order
+// of kps. Returns false as soon as a write fails.
+bool detect_scheduled(const std::vector<Keypoint> &kps, KeypointTask &task);
+
+// Instantiated for the pixel types of pixel.h. The table lut is only used
+// with 8bit images.
+template <typename T>
+void detect_keypoint(const T *im, int nx, int ny, size_t stride,
+                     int x, int y, int r, int L, int flag_norm, float epsilon,
+                     bool keep_histos, KeypointResult &res, const OrientationLut *lut = NULL);
+void detect_keypoint_field(const float *norm, const float *theta, int nx, int ny, size_t stride,
+                           int x, int y, int r, int L, int flag_norm, float epsilon,
+                           bool keep_histos, KeypointResult &res);
+
+#endif // KEYPOINT_H_INCLUDED
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <limits.h>
+#include <new>
+#include <vector>
+
+#include "Histo.h"
+#include "modes_detection.h"
+#include "keypoint.h"
+#include "libmodes.h"
+
+using namespace std;
+
+// No C++ exception may cross the C interface : every entry point catches
+// them and returns -1 instead.
+
+static int check_image(const float *im, size_t nx, size_t ny, size_t stride)
+{
+    // The detection works on int coordinates
+    if (nx > INT_MAX || ny > INT_MAX)
+        return -1;
+    return (im != NULL && nx > 0 && ny > 0 && stride >= nx) ? 0 : -1;
+}
+
+int modes_version(void)
+{
+    return LIBMODES_VERSION;
+}
+
+int modes_histogram(const float *im, size_t nx, size_t ny, size_t stride,
+                    int x, int y, int r, int n_bins,
+                    int flag_norm, int flag_gauss, float *histo)
+{
+    if (check_image(im, nx, ny, stride) < 0 || n_bins < 2 || histo == NULL)
+        return -1;
+
+    try {
+        Histo h = histo_orientation(im,nx,ny,stride,x,y,r,n_bins,flag_norm,flag_gauss);
+        for (int i(0); i < n_bins; i++)
+            histo[i] = h.get_data()[i];
+    } catch (...) {
+        return -1;
+    }
+    return 0;
+}
+
+int modes_detect(const float *histo, int n_bins, float epsilon,
+                 modes_mode *modes, int max_modes)
+{
+    if (histo == NULL || n_bins < 2 || (modes == NULL && max_modes > 0))
+        return -1;
+
+    try {
+        Histo h(n_bins, histo);
+        vector<float> list = max_modes_detection(h, epsilon);
+        int n = list.size()/3;
+        for (int i(0); i < n && i < max_modes; i++) {
+            modes[i].a = list[3*i];
+            modes[i].b = list[3*i+1];
+            modes[i].orientation = compute_orientation(h, modes[i].a, modes[i].b);
+            modes[i].log_nfa = list[3*i+2];
+        }
+        return n;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int modes_detect_keypoints(const float *im, size_t nx, size_t ny, size_t stride,
+                           const modes_keypoint *kp, size_t n_kp,
+                           int n_bins, int flag_norm, float epsilon,
+                           modes_summary *summary,
+                           modes_mode *modes, int max_modes,
+                           modes_peak *peaks, int max_peaks,
+                           float *histo_ac, float *histo_lowe)
+{
+    if (check_image(im, nx, ny, stride) < 0 || n_bins < 2)
+        return -1;
+    if ((kp == NULL || summary == NULL) && n_kp > 0)
+        return -1;
+    if ((modes == NULL && max_modes > 0) || (peaks == NULL && max_peaks > 0))
+        return -1;
+
+    try {
+        KeypointResult res;
+        bool keep_histos = (histo_ac != NULL || histo_lowe != NULL);
+
+        // The results are stored at the index of their keypoint, hence the
+        // keypoints can be processed in the order of keypoints_schedule()
+        vector<Keypoint> kps(n_kp);
+        for (size_t k(0); k < n_kp; k++) {
+            kps[k].x = kp[k].x;
+            kps[k].y = kp[k].y;
+            kps[k].r = kp[k].r;
+        }
+        vector<size_t> order;
+        keypoints_schedule(kps, 0, n_kp, order);
+
+        for (size_t i(0); i < n_kp; i++) {
+            size_t k = order[i];
+            detect_keypoint(im, nx, ny, stride, kp[k].x, kp[k].y, kp[k].r,
+                            n_bins, flag_norm, epsilon, keep_histos, res);
+
+            summary[k].nb_pixels = res.nb_pixels;
+            summary[k].n_modes = res.modes.size();
+            summary[k].n_peaks = res.peaks.size();
+
+            for (int m(0); m < max_modes && m < summary[k].n_modes; m++) {
+                modes_mode &out = modes[k*max_modes+m];
+                out.a = res.modes[m].a;
+                out.b = res.modes[m].b;
+                out.orientation = res.modes[m].orientation;
+                out.log_nfa = res.modes[m].log_nfa;
+            }
+            for (int p(0); p < max_peaks && p < summary[k].n_peaks; p++) {
+                modes_peak &out = peaks[k*max_peaks+p];
+                out.bin = res.peaks[p].bin;
+                out.orientation = res.peaks[p].orientation;
+                out.ratio = res.peaks[p].ratio;
+            }
+            for (int b(0); b < n_bins; b++) {
+                if (histo_ac)
+                    histo_ac[k*n_bins+b] = res.histo_ac[b];
+                if (histo_lowe)
+                    histo_lowe[k*n_bins+b] = res.histo_lowe[b];
+            }
+        }
+    } catch (...) {
+        return -1;
+    }
+    return 0;
+}
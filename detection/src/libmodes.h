@@ -0,0 +1,80 @@
+#ifndef LIBMODES_H
+#define LIBMODES_H
+
+/*
+ * C interface of the orientation modes library.
+ *
+ * All the buffers are owned by the caller, and nothing is read from or
+ * written to files. The image is a gray float array where the pixel of
+ * coordinates (i,j) is stored in im[j*stride+i]. All the functions
+ * return a negative value if an error happens.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LIBMODES_VERSION 1
+
+/* keypoint (x,y) at scale r */
+typedef struct modes_keypoint {
+    int x;
+    int y;
+    int r;
+} modes_keypoint;
+
+/* mode [a,b] of the a contrario detection, with its -log(NFA) */
+typedef struct modes_mode {
+    int a;
+    int b;
+    float orientation;
+    float log_nfa;
+} modes_mode;
+
+/* local maximum of Lowe's detection, with its ratio to the global maximum */
+typedef struct modes_peak {
+    int bin;
+    float orientation;
+    float ratio;
+} modes_peak;
+
+/* per keypoint counts: n_modes and n_peaks can exceed the capacity given
+ * by the caller, in which case only the first ones are stored */
+typedef struct modes_summary {
+    int nb_pixels;
+    int n_modes;
+    int n_peaks;
+} modes_summary;
+
+int modes_version(void);
+
+/* histogram of orientations of the disc of radius r around (x,y), written
+ * in the n_bins floats of histo */
+int modes_histogram(const float *im, size_t nx, size_t ny, size_t stride,
+                    int x, int y, int r, int n_bins,
+                    int flag_norm, int flag_gauss, float *histo);
+
+/* a contrario detection of modes in histo; returns the number of modes,
+ * of which at most max_modes are stored in modes */
+int modes_detect(const float *histo, int n_bins, float epsilon,
+                 modes_mode *modes, int max_modes);
+
+/* full processing of n_kp keypoints: for keypoint k, summary[k] is filled,
+ * the modes are stored in modes[k*max_modes...] and the peaks in
+ * peaks[k*max_peaks...]. histo_ac and histo_lowe receive n_bins floats per
+ * keypoint, and can be NULL. */
+int modes_detect_keypoints(const float *im, size_t nx, size_t ny, size_t stride,
+                           const modes_keypoint *kp, size_t n_kp,
+                           int n_bins, int flag_norm, float epsilon,
+                           modes_summary *summary,
+                           modes_mode *modes, int max_modes,
+                           modes_peak *peaks, int max_peaks,
+                           float *histo_ac, float *histo_lowe);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBMODES_H */
@@ -31,89 +31,557 @@
  * or implied, of the copyright holder.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
 #include <iostream>
-#include <fstream>
 #include <vector>
 using namespace std;
 
-#include "libpng_io.h"
-#include "Histo.h"
+#include "io_png.h"
+#include "keypoint.h"
+#include "result_io.h"
+#include "column_store.h"
+#include "image_mmap.h"
+#include "tiled_image.h"
+#include "shared_image.h"
+#include "pipeline.h"
+#include "image_cache.h"
+#include "pixel.h"
+#include "orientation_lut.h"
+#include "planner.h"
+#include "padded_image.h"
+#include "cpu_dispatch.h"
 #include "modes_detection.h"
 
 #define EPSILON 1
+#define TILE_SIZE 512
 
-int main(int c, char *v[])
+// Orientation estimation with the two methods (A Contrario detection and
+// Lowe's detection) for all the keypoints. The image im contains the window
+// of nx columns and ny lines of the original image starting at (x0,y0). The
+// results go to the sinks, or to the text files if there is none. The table
+// lut is used with 8bit images. If the gradient field norm, theta of the
+// window is given, the histograms are computed from it instead of im. The
+// keypoints are processed by detect_scheduled(), and the results are written
+// in the order of kps.
+template <typename T>
+class WindowTask : public KeypointTask
 {
-    // Parameters loading
-    if (c < 7) {
-        cout << "missing arguments" << endl;
-        cout << "usage: " << v[0] << " image x y r n_bins flag_norm" << endl;
-        return 1;
+public :
+    WindowTask(const T *im, size_t nx, size_t ny, size_t stride, size_t x0, size_t y0,
+               int n_bins, int flag_norm, bool with_histos, vector<ResultSink*> &sinks,
+               const OrientationLut *lut, const float *norm, const float *theta)
+        : m_im(im), m_nx(nx), m_ny(ny), m_stride(stride), m_x0(x0), m_y0(y0), m_n_bins(n_bins),
+          m_flag_norm(flag_norm), m_histos(with_histos || sinks.empty()), m_sinks(sinks), m_lut(lut),
+          m_norm(norm), m_theta(theta)
+    {
     }
 
-    char *image_file = v[1];
-    int x = atoi(v[2]);
-    int y = atoi(v[3]);
-    int r = atoi(v[4]);
-    int n_bins = atoi(v[5]);
-    int flag_norm = atoi(v[6]);
+    void detect(const Keypoint &kp, KeypointResult &res)
+    {
+        if (m_norm)
+            detect_keypoint_field(m_norm,m_theta,m_nx,m_ny,m_stride,kp.x-(int)m_x0,kp.y-(int)m_y0,kp.r,
+                                  m_n_bins,m_flag_norm,EPSILON,m_histos,res);
+        else
+            detect_keypoint(m_im,m_nx,m_ny,m_stride,kp.x-(int)m_x0,kp.y-(int)m_y0,kp.r,m_n_bins,
+                            m_flag_norm,EPSILON,m_histos,res,m_lut);
+    }
 
-    // Image loading
-    size_t nx, ny;
-    float *im = read_png_f32_gray(image_file, &nx, &ny);
+    bool write(const Keypoint &kp, const KeypointResult &res)
+    {
+        bool ok = true;
+        if (m_sinks.empty())
+            write_text_results(res, m_n_bins);
+        for (size_t s(0); s < m_sinks.size(); s++)
+            ok = m_sinks[s]->write(kp, res) && ok;
+        return ok;
+    }
 
+private :
+    const T *m_im;
+    size_t m_nx, m_ny, m_stride, m_x0, m_y0;
+    int m_n_bins;
+    int m_flag_norm;
+    bool m_histos; // the text files need the histograms
+    vector<ResultSink*> &m_sinks;
+    const OrientationLut *m_lut;
+    const float *m_norm;
+    const float *m_theta;
+};
 
-    // First step : A Contrario detection
+template <typename T>
+static bool process_keypoints(const T *im, size_t nx, size_t ny, size_t stride, size_t x0, size_t y0,
+                              const vector<Keypoint> &kps, int n_bins, int flag_norm,
+                              bool with_histos, vector<ResultSink*> &sinks,
+                              const OrientationLut *lut = NULL,
+                              const float *norm = NULL, const float *theta = NULL)
+{
+    WindowTask<T> task(im, nx, ny, stride, x0, y0, n_bins, flag_norm, with_histos, sinks,
+                       lut, norm, theta);
+    return detect_scheduled(kps, task);
+}
 
-    // Create and save histogram
-    Histo h_ac = histo_orientation(im,nx,ny,x,y,r,n_bins,flag_norm,0);
-    h_ac.print("histo_ac.txt");
+// The table of the planner is only for 8bit images
+template <typename T>
+static bool is_u8(const T *)
+{
+    return false;
+}
 
-    // Save the number of pixels used for the histogram construction
-    ofstream flux("nb_pixels_ac.txt");
-    flux << h_ac.get_M() << endl;
-    flux.close();
+static bool is_u8(const unsigned char *)
+{
+    return true;
+}
 
-    // Detect modes
-    vector<float> modes = max_modes_detection(h_ac,EPSILON);
+// Same as process_keypoints(), with the strategy chosen by the planner : the
+// gradient field of the pixels read by the keypoints is computed first, or
+// the gradients of a 8bit image are binned with the table of the planner.
+// padded tells that im is a PaddedImage, whose field is computed without
+// testing the borders.
+template <typename T>
+static bool process_image(const T *im, size_t nx, size_t ny, size_t stride, size_t x0, size_t y0,
+                          const vector<Keypoint> &kps, int n_bins, int flag_norm,
+                          bool with_histos, vector<ResultSink*> &sinks, Planner &planner,
+                          bool padded = false)
+{
+    Strategy strategy = planner.plan(kps, x0, y0, nx, ny, is_u8(im));
+    if (strategy == STRATEGY_LUT)
+        return process_keypoints(im, nx, ny, stride, x0, y0, kps, n_bins, flag_norm,
+                                 with_histos, sinks, planner.get_lut());
+
+    size_t wx0, wy0, wx1, wy1;
+    keypoints_window(kps, x0, y0, nx, ny, wx0, wy0, wx1, wy1);
+    if (strategy == STRATEGY_DIRECT || wx0 == wx1 || wy0 == wy1)
+        return process_keypoints(im, nx, ny, stride, x0, y0, kps, n_bins, flag_norm,
+                                 with_histos, sinks);
 
-    // Save modes, orientations and NFA (approximated)
-    flux.open("modes_ac.txt");
-    for (int i(0); i<modes.size()/3.0; i++) {
-        flux << "[" << modes[3*i] << "," << modes[3*i+1] << "]" << " ; "
-             << compute_orientation(h_ac,modes[3*i],modes[3*i+1]) << " ; "
-             << modes[3*i+2] << endl;
+    // The keypoints are processed on the window of the field, with the same
+    // results
+    size_t w = wx1 - wx0, h = wy1 - wy0;
+    const T *window = im + (wy0 - y0) * stride + (wx0 - x0);
+    vector<float> norm(h * stride + 1), theta(h * stride + 1);
+    if (padded)
+        orientation_field_padded(window, w, h, stride, &norm[0], &theta[0]);
+    else
+        orientation_field(window, w, h, stride, &norm[0], &theta[0]);
+    return process_keypoints(window, w, h, stride, wx0, wy0, kps, n_bins, flag_norm,
+                             with_histos, sinks, NULL, &norm[0], &theta[0]);
+}
+
+// Results of the keypoints processed out of order, put back in the order of
+// kps. The writes of a bucket come in the order of its keypoints, whose
+// indices in kps are given by set_bucket(). The results of the first
+// keypoints are written to the sinks, or to the text files if there is
+// none, as soon as they are all known.
+class OrderedSink : public ResultSink
+{
+public :
+    OrderedSink(const vector<Keypoint> &kps, int n_bins, vector<ResultSink*> &sinks)
+        : m_kps(kps), m_n_bins(n_bins), m_sinks(sinks), m_results(kps.size()),
+          m_done(kps.size(), false), m_next(0), m_bucket(NULL), m_k(0)
+    {
+    }
+
+    void set_bucket(const vector<size_t> &bucket)
+    {
+        m_bucket = &bucket;
+        m_k = 0;
+    }
+
+    bool write(const Keypoint &, const KeypointResult &res)
+    {
+        size_t k = (*m_bucket)[m_k++];
+        m_results[k] = res;
+        m_done[k] = true;
+
+        bool ok = true;
+        for (; m_next < m_kps.size() && m_done[m_next]; m_next++) {
+            if (m_sinks.empty())
+                write_text_results(m_results[m_next], m_n_bins);
+            for (size_t s(0); s < m_sinks.size(); s++)
+                ok = m_sinks[s]->write(m_kps[m_next], m_results[m_next]) && ok;
+            m_results[m_next] = KeypointResult();
+        }
+        return ok;
     }
-    flux.close();
 
+    bool close()
+    {
+        return true;
+    }
+
+private :
+    const vector<Keypoint> &m_kps;
+    int m_n_bins;
+    vector<ResultSink*> &m_sinks;
+    vector<KeypointResult> m_results; // results waiting for the previous ones
+    vector<bool> m_done;
+    size_t m_next; // first keypoint whose result is not written
+    const vector<size_t> *m_bucket;
+    size_t m_k; // next keypoint of the bucket
+};
 
+// Processing of a PGM or raw float32 image read by tiles, within a memory
+// budget. The keypoints are bucketed by the tile of their center, and each
+// bucket is processed once, on the window of the pixels read by its keypoints,
+// copied from the cached tiles. The results are written in the order of kps.
+// read_ok is false if a window could not be read.
+static bool process_tiled(TiledImage &tiled, const vector<Keypoint> &kps, int n_bins, int flag_norm,
+                          bool with_histos, vector<ResultSink*> &sinks, Planner &planner,
+                          bool &read_ok)
+{
+    size_t nx = tiled.get_nx(), ny = tiled.get_ny(), ts = tiled.get_tile_size();
+    size_t ntx = max((size_t) 1, (nx + ts - 1) / ts);
 
-    // Second step : Lowe's detection
+    // The keypoints outside the image go to the nearest tile
+    map<size_t, vector<size_t> > buckets;
+    for (size_t k(0); k < kps.size(); k++) {
+        size_t i = min((size_t) max(kps[k].x, 0), nx ? nx - 1 : 0);
+        size_t j = min((size_t) max(kps[k].y, 0), ny ? ny - 1 : 0);
+        buckets[(j / ts) * ntx + i / ts].push_back(k);
+    }
 
-    // Create and save histogram
-    // For Lowe's peak detection, histogram has to be weighted with gradient norms
-    Histo h_lowe = histo_orientation(im,nx,ny,x,y,r,n_bins,1,1);
-    h_lowe.print("histo_lowe.txt");
+    // The text files need the histograms
+    OrderedSink ordered(kps, n_bins, sinks);
+    vector<ResultSink*> bucket_sinks(1, &ordered);
+    with_histos = with_histos || sinks.empty();
 
-    // Detect local maxima
-    vector<int> maxima;
-    float max_histo = h_lowe.max();
+    PaddedImage<unsigned char> window8;
+    PaddedImage<be16> window16;
+    PaddedImage<float> window;
+    vector<Keypoint> bucket_kps;
+    bool ok = true;
+    read_ok = true;
+    for (map<size_t, vector<size_t> >::iterator it = buckets.begin(); ok && it != buckets.end(); ++it) {
+        bucket_kps.clear();
+        for (size_t i(0); i < it->second.size(); i++)
+            bucket_kps.push_back(kps[it->second[i]]);
+        ordered.set_bucket(it->second);
 
-    for (int i(0); i<n_bins; i++)
-        if ((h_lowe[i] > 0.8*max_histo) && (h_lowe[i] > h_lowe[i-1]) && (h_lowe[i] > h_lowe[i+1]))
-            maxima.push_back(i);
+        size_t x0, x1, y0, y1;
+        keypoints_cols(bucket_kps, nx, x0, x1);
+        keypoints_rows(bucket_kps, ny, y0, y1);
+        size_t w = x1 - x0, h = y1 - y0;
 
-    // Save orientations associated to local maxima
-    flux.open("modes_lowe.txt");
-    for (size_t i(0); i<maxima.size(); i++) {
-        flux <<  "[" << maxima[i] << "," << maxima[i] << "]" << " ; "
-             << h_lowe.angle(maxima[i],1) << " ; "
-             << h_lowe[maxima[i]]/max_histo << endl;
+        switch (tiled.get_type()) {
+        case PIXEL_U8:
+            read_ok = load_window(tiled, x0, y0, x1, y1, window8);
+            ok = read_ok && process_image(window8.get_data(), w, h, window8.get_stride(), x0, y0,
+                                          bucket_kps, n_bins, flag_norm, with_histos, bucket_sinks,
+                                          planner, true);
+            break;
+        case PIXEL_U16:
+            read_ok = load_window(tiled, x0, y0, x1, y1, window16);
+            ok = read_ok && process_image(window16.get_data(), w, h, window16.get_stride(), x0, y0,
+                                          bucket_kps, n_bins, flag_norm, with_histos, bucket_sinks,
+                                          planner, true);
+            break;
+        default:
+            read_ok = load_window(tiled, x0, y0, x1, y1, window);
+            ok = read_ok && process_image(window.get_data(), w, h, window.get_stride(), x0, y0,
+                                          bucket_kps, n_bins, flag_norm, with_histos, bucket_sinks,
+                                          planner, true);
+        }
     }
-    flux.close();
+    return ok;
+}
 
+// Map the gray image fname and its gradient field (if with_field) from the
+// cache dir, decoding them into it if needed. The cache is only a shortcut :
+// if it cannot be used (directory, disk full...), the image is decoded as
+// without it.
+static bool open_cached(ImageCache &cache, const char *dir, size_t budget, const char *fname,
+                        bool with_field, MappedImage &image, MappedImage &field, bool verbose)
+{
+    string key;
+    if (cache.open(dir, budget) && cache.key(fname, key) && cache.get_image(key, fname, image)
+        && (!with_field || cache.get_field(key, image, field)))
+        return true;
 
-    // Clear memory
-    delete im;
+    if (verbose)
+        fprintf(stderr, "cache %s unusable, decoding %s\n", dir, fname);
+    image.close();
+    field.close();
+    cache.evict();
+    return false;
+}
+
+static void usage(const char *name)
+{
+    cout << "usage: " << name << " [-o results.bin] [-c dir] [-H] [-8] [-m MiB] [-S] [-g] [-s strategy] [-v] image x y r n_bins flag_norm" << endl;
+    cout << "       " << name << " -k keypoints.txt [-o results.bin] [-c dir] [-H] [-8] [-m MiB] [-S] [-g] [-s strategy] [-v] image n_bins flag_norm" << endl;
+    cout << "       " << name << " -p jobs.txt [-j D,G,T] [-H] [-g] [-s strategy] [-v] n_bins flag_norm" << endl;
+    cout << "  -k file  process all the keypoints of file, given as \"x y r\" lines" << endl;
+    cout << "  -o file  write the results in the binary stream file (default modes.bin" << endl;
+    cout << "           with -k) instead of the text files" << endl;
+    cout << "  -c dir   write the results in the columnar store dir" << endl;
+    cout << "  -H       also store the histograms in the binary stream" << endl;
+    cout << "  -8       decode PNG images as 8bit gray (color images are rounded)" << endl;
+    cout << "  -m MiB   read PGM and raw float32 images by tiles, with at most MiB" << endl;
+    cout << "           megabytes of cached tiles" << endl;
+    cout << "  -S       share the decoded PNG image with the other processes of the" << endl;
+    cout << "           host, through POSIX shared memory" << endl;
+    cout << "  -g       compute the gradient field of the image once, and build the" << endl;
+    cout << "           histograms from it (shared too with -S), same as -s field" << endl;
+    cout << "  -s name  strategy used to build the histograms : auto (default, the" << endl;
+    cout << "           fastest estimated one), direct, field or lut (8bit images)" << endl;
+    cout << "  -v       log the strategy chosen for each image, band or window" << endl;
+    cout << "  -C dir   cache the decoded PNG images (and gradient fields with -g) in" << endl;
+    cout << "           dir, to map them in the next runs" << endl;
+    cout << "  -Z MiB   size of the cache (default 1024)" << endl;
+    cout << "  -p file  process the PNG images of file, given as \"image keypoints.txt" << endl;
+    cout << "           results.bin\" lines, in a pipeline of decoding, gradient and" << endl;
+    cout << "           detection stages" << endl;
+    cout << "  -j D,G,T number of threads of the three stages (default 1,1,1)" << endl;
+}
+
+int main(int c, char *v[])
+{
+    // Options loading
+    const char *keypoints_file = NULL;
+    const char *output_file = NULL;
+    const char *column_dir = NULL;
+    bool with_histos = false;
+    bool u8 = false;
+    size_t budget = 0;
+    bool shared = false;
+    Strategy strategy = STRATEGY_AUTO;
+    bool verbose = false;
+    const char *cache_dir = NULL;
+    size_t cache_budget = (size_t) 1024 << 20;
+    const char *jobs_file = NULL;
+    PipelineThreads threads = {1, 1, 1};
+    int opt;
+    // The options stop at the image name ("+" for GNU getopt), so that the
+    // coordinates can be negative
+    while ((opt = getopt(c, v, "+k:o:c:H8m:SgC:Z:p:j:s:v")) != -1) {
+        switch (opt) {
+        case 'k':
+            keypoints_file = optarg;
+            break;
+        case 'o':
+            output_file = optarg;
+            break;
+        case 'c':
+            column_dir = optarg;
+            break;
+        case 'H':
+            with_histos = true;
+            break;
+        case '8':
+            u8 = true;
+            break;
+        case 'm':
+            budget = (size_t) atol(optarg) << 20;
+            break;
+        case 'S':
+            shared = true;
+            break;
+        case 'g':
+            strategy = STRATEGY_FIELD;
+            break;
+        case 's':
+            if (!parse_strategy(optarg, strategy)) {
+                usage(v[0]);
+                return 1;
+            }
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        case 'C':
+            cache_dir = optarg;
+            break;
+        case 'Z':
+            cache_budget = (size_t) atol(optarg) << 20;
+            break;
+        case 'p':
+            jobs_file = optarg;
+            break;
+        case 'j':
+            if (sscanf(optarg, "%d,%d,%d", &threads.decode, &threads.gradient, &threads.detect) != 3) {
+                usage(v[0]);
+                return 1;
+            }
+            break;
+        default:
+            usage(v[0]);
+            return 1;
+        }
+    }
+
+    // Parameters loading
+    vector<Keypoint> kps;
+    int n_params = jobs_file ? 2 : (keypoints_file ? 3 : 6);
+    if (c - optind < n_params) {
+        cout << "missing arguments" << endl;
+        usage(v[0]);
+        return 1;
+    }
+
+    char *image_file = jobs_file ? NULL : v[optind++];
+    if (jobs_file) {
+        // The keypoints of each image are read by the pipeline
+    } else if (keypoints_file) {
+        if (!read_keypoints(keypoints_file, kps)) {
+            cerr << "unable to read keypoints from " << keypoints_file << endl;
+            return 1;
+        }
+        if (!output_file && !column_dir)
+            output_file = "modes.bin";
+    } else {
+        Keypoint kp;
+        kp.x = atoi(v[optind++]);
+        kp.y = atoi(v[optind++]);
+        kp.r = atoi(v[optind++]);
+        kps.push_back(kp);
+    }
+    int n_bins = atoi(v[optind++]);
+    int flag_norm = atoi(v[optind++]);
+
+    // Strategy of each image, band or window, with the table of the 8bit
+    // gradients built only if it is chosen. The gradient fields of the shared
+    // and cached images are only stored if the field strategy is forced.
+    Planner planner(n_bins, strategy, verbose);
+    bool with_field = (strategy == STRATEGY_FIELD);
+
+    // Kernels of the processor (or of MODES_ISA), also for the conversion
+    // of the RGB images to gray
+    const Kernels &kernel = kernels();
+    io_png_set_gray_converters(kernel.gray_rgb_f32, kernel.gray_rgb_u8);
+    if (verbose)
+        fprintf(stderr, "kernels: %s\n", isa_name(kernels_isa()));
+
+    // Multi-image pipeline : each image has its own keypoints and results
+    if (jobs_file) {
+        vector<PipelineJob> jobs;
+        if (!read_jobs(jobs_file, jobs)) {
+            cerr << "unable to read jobs from " << jobs_file << endl;
+            return 1;
+        }
+        return run_pipeline(jobs, n_bins, flag_norm, EPSILON, with_histos, planner, threads) ? 0 : 1;
+    }
+
+    // Destinations of the results. Without any, the text files are written.
+    vector<ResultSink*> sinks;
+    ResultWriter writer;
+    ColumnWriter columns;
+    if (output_file) {
+        if (!writer.open(output_file, n_bins, with_histos)) {
+            cerr << "unable to open " << output_file << endl;
+            return 1;
+        }
+        sinks.push_back(&writer);
+    }
+    if (column_dir) {
+        if (!columns.open(column_dir, n_bins)) {
+            cerr << "unable to create the column store " << column_dir << endl;
+            return 1;
+        }
+        sinks.push_back(&columns);
+    }
+
+    bool ok;
+    ImageCache cache;
+    MappedImage cached_image, cached_field;
+    if (budget) {
+        TiledImage tiled;
+        if (!tiled.open(image_file, TILE_SIZE, budget)) {
+            cerr << "unable to read image " << image_file << " (-m needs a PGM or raw float32 image)" << endl;
+            return 1;
+        }
+        bool read_ok;
+        ok = process_tiled(tiled, kps, n_bins, flag_norm, with_histos, sinks, planner, read_ok);
+        if (!read_ok) {
+            cerr << "unable to read image " << image_file << endl;
+            return 1;
+        }
+    } else if (shared && !MappedImage::is_mappable(image_file)) {
+        // PNG image decoded once for all the processes of the host. The
+        // memory-mapped images are already shared through the page cache.
+        SharedImage image;
+        if (!image.open(image_file, with_field)) {
+            cerr << "unable to read image " << image_file << endl;
+            return 1;
+        }
+        size_t nx = image.get_nx(), ny = image.get_ny();
+        if (with_field)
+            ok = process_keypoints(image.get_data(), nx, ny, nx, 0, 0, kps, n_bins, flag_norm,
+                                   with_histos, sinks, NULL, image.get_norm(), image.get_theta());
+        else
+            ok = process_image(image.get_data(), nx, ny, nx, 0, 0, kps, n_bins, flag_norm,
+                               with_histos, sinks, planner);
+    } else if (cache_dir && !MappedImage::is_mappable(image_file)
+               && open_cached(cache, cache_dir, cache_budget, image_file, with_field,
+                              cached_image, cached_field, verbose)) {
+        // PNG image decoded once, then mapped from the cache
+        size_t nx = cached_image.get_nx(), ny = cached_image.get_ny(), stride = cached_image.get_stride();
+        const float *norm = (const float *) cached_field.get_data();
+        if (with_field)
+            ok = process_keypoints((const float *) cached_image.get_data(), nx, ny, stride, 0, 0, kps,
+                                   n_bins, flag_norm, with_histos, sinks, NULL,
+                                   norm, norm + ny * stride);
+        else
+            ok = process_image((const float *) cached_image.get_data(), nx, ny, stride, 0, 0, kps,
+                               n_bins, flag_norm, with_histos, sinks, planner);
+        cache.evict();
+    } else if (MappedImage::is_mappable(image_file)) {
+        // PGM and raw float32 images are memory-mapped and used in place
+        MappedImage mapped;
+        if (!mapped.open(image_file)) {
+            cerr << "unable to read image " << image_file << endl;
+            return 1;
+        }
+
+        size_t nx = mapped.get_nx(), ny = mapped.get_ny(), stride = mapped.get_stride();
+        switch (mapped.get_type()) {
+        case PIXEL_U8:
+            ok = process_image((const unsigned char *) mapped.get_data(), nx, ny, stride, 0, 0,
+                               kps, n_bins, flag_norm, with_histos, sinks, planner);
+            break;
+        case PIXEL_U16:
+            ok = process_image((const be16 *) mapped.get_data(), nx, ny, stride, 0, 0,
+                               kps, n_bins, flag_norm, with_histos, sinks, planner);
+            break;
+        default:
+            ok = process_image((const float *) mapped.get_data(), nx, ny, stride, 0, 0,
+                               kps, n_bins, flag_norm, with_histos, sinks, planner);
+        }
+    } else {
+        // PNG image : only the band of lines needed by the keypoints is
+        // decoded and kept, in a padded image. The height of the image is
+        // unknown before decoding, hence the band is computed with
+        // ny = INT_MAX, then bounded by the reader. With -8, the pixels stay
+        // 8bit integers.
+        size_t nx, ny, y0, y1;
+        keypoints_rows(kps, INT_MAX, y0, y1);
+        PngReader reader;
+        PaddedImage<unsigned char> im8;
+        PaddedImage<float> im;
+        if (u8 ? !load_png_rows(reader, image_file, nx, ny, y0, y1, im8)
+               : !load_png_rows(reader, image_file, nx, ny, y0, y1, im)) {
+            cerr << "unable to read image " << image_file << endl;
+            return 1;
+        }
+
+        if (u8)
+            ok = process_image(im8.get_data(), nx, y1-y0, im8.get_stride(), 0, y0,
+                               kps, n_bins, flag_norm, with_histos, sinks, planner, true);
+        else
+            ok = process_image(im.get_data(), nx, y1-y0, im.get_stride(), 0, y0,
+                               kps, n_bins, flag_norm, with_histos, sinks, planner, true);
+    }
+
+    for (size_t s(0); s < sinks.size(); s++)
+        ok = sinks[s]->close() && ok;
+    if (!ok) {
+        cerr << "error while writing the results" << endl;
+        return 1;
+    }
+    return 0;
 }
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+using namespace std;
+
+#include "io_png.h"
+#include "image_mmap.h"
+
+// One-off conversion of a PNG image to the formats that modes_detection can
+// memory-map : 8bit PGM (*.pgm) or raw float32 (any other extension). The
+// raw float32 image is exactly the gray image of the PNG path, while the PGM
+// conversion of a color image rounds the gray values down to integers.
+int main(int c, char *v[])
+{
+    if (c < 3) {
+        cout << "usage: " << v[0] << " image.png output.pgm|output.f32" << endl;
+        return 1;
+    }
+
+    size_t nx, ny;
+    size_t len = strlen(v[2]);
+    bool ok;
+    if (len > 4 && strcmp(v[2] + len - 4, ".pgm") == 0) {
+        unsigned char *im = read_png_u8_gray(v[1], &nx, &ny);
+        if (!im) {
+            cerr << "unable to read image " << v[1] << endl;
+            return 1;
+        }
+        ok = write_pgm(v[2], im, nx, ny);
+        free(im);
+    } else {
+        float *im = read_png_f32_gray(v[1], &nx, &ny);
+        if (!im) {
+            cerr << "unable to read image " << v[1] << endl;
+            return 1;
+        }
+        ok = write_raw_f32(v[2], im, nx, ny);
+        free(im);
+    }
+
+    if (!ok) {
+        cerr << "unable to write " << v[2] << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -36,7 +36,11 @@
 #include <vector>
 #include <math.h>
 
+#include "CountHisto.h"
 #include "Histo.h"
+#include "cpu_dispatch.h"
+#include "instrument.h"
+#include "pixel.h"
 #include "modes_detection.h"
 
 using namespace std;
@@ -47,11 +51,15 @@ using namespace std;
 // If the parameter flag_norm is set to 1 the histogram is weighted by the norm
 // of gradient, else it is not. If the parameter flag_gauss is set to 1 the histogram
 // is weighted by a Gaussian-weighted circular window with a standard deviation that
-// is 1.5 times that of the scale, r, of the keypoint.
-Histo histo_orientation(float *im, int nx, int ny, int x, int y, int r, int L, int flag_norm, int flag_gauss)
+// is 1.5 times that of the scale, r, of the keypoint. Consecutive lines of the
+// image are stride pixels apart. The pixels can be of any of the types of pixel.h.
+template <typename T>
+Histo histo_orientation(const T *im, int nx, int ny, size_t stride, int x, int y, int r, int L, int flag_norm, int flag_gauss)
 {
+    MODES_STAGE(STAGE_HISTO);
     Histo histo(L);
     int count(0);
+    MODES_LOCAL_COUNTER(visited);
 
     if (flag_gauss) {
         float sigma = 1.5*r;
@@ -60,10 +68,11 @@ Histo histo_orientation(float *im, int nx, int ny, int x, int y, int r, int L, i
             for (int j = max(1,(int) (y-3*sigma)); j <= min((int) (y+3*sigma),ny-2); j++) {
                 // The contributing pixels are in a circle centered in (x,y)
                 if ((i-x)*(i-x)+(j-y)*(j-y) <= 9*sigma*sigma) {
+                    MODES_TALLY(visited);
                     // Computation of the gradient : the pixel of coordinates (k,l)
-                    // is stored in im[l*nx+k]
-                    float gx = im[j*nx+i+1]-im[j*nx+i-1];
-                    float gy = -im[(j+1)*nx+i]+im[(j-1)*nx+i];
+                    // is stored in im[l*stride+k]
+                    float gx = pixel_value(im[j*stride+i+1])-pixel_value(im[j*stride+i-1]);
+                    float gy = -pixel_value(im[(j+1)*stride+i])+pixel_value(im[(j-1)*stride+i]);
                     float norm = sqrtf(gx*gx+gy*gy);
 
                     if (flag_norm) {
@@ -102,10 +111,11 @@ Histo histo_orientation(float *im, int nx, int ny, int x, int y, int r, int L, i
             for (int j = max(1,(y-r)); j <= min((y+r),ny-2); j++) {
                 // The contributing pixels are in a circle centered in (x,y)
                 if ((i-x)*(i-x)+(j-y)*(j-y) <= r*r) {
+                    MODES_TALLY(visited);
                     // Computation of the gradient : the pixel of coordinates (k,l)
-                    // is stored in im[l*nx+k]
-                    float gx = im[j*nx+i+1]-im[j*nx+i-1];
-                    float gy = -im[(j+1)*nx+i]+im[(j-1)*nx+i];
+                    // is stored in im[l*stride+k]
+                    float gx = pixel_value(im[j*stride+i+1])-pixel_value(im[j*stride+i-1]);
+                    float gy = -pixel_value(im[(j+1)*stride+i])+pixel_value(im[(j-1)*stride+i]);
                     float norm = sqrtf(gx*gx+gy*gy);
 
                     if (flag_norm) {
@@ -145,16 +155,353 @@ Histo histo_orientation(float *im, int nx, int ny, int x, int y, int r, int L, i
     if (histo.get_M() > 0)
         histo *= count/histo.get_M();
 
+    MODES_COUNT(COUNT_PIXELS, visited);
+    if (!flag_norm)
+        MODES_COUNT(COUNT_PIXELS_THRESHOLD, count);
     return histo;
 }
 
+template Histo histo_orientation(const float*, int, int, size_t, int, int, int, int, int, int);
+template Histo histo_orientation(const unsigned char*, int, int, size_t, int, int, int, int, int, int);
+template Histo histo_orientation(const be16*, int, int, size_t, int, int, int, int, int, int);
+
+
+// Same as histo_orientation() on a 8bit image, with the number of bins of the
+// table lut. The gradient components are integers, their bin and norm are read
+// in the table and the a contrario threshold is compared to the squared norm.
+Histo histo_orientation_lut(const unsigned char *im, int nx, int ny, size_t stride, int x, int y, int r, const OrientationLut &lut, int flag_norm, int flag_gauss)
+{
+    MODES_STAGE(STAGE_HISTO);
+    Histo histo(lut.get_L());
+    int count(0);
+    MODES_LOCAL_COUNTER(visited);
+    int ac_n2(lut.get_ac_n2());
+
+    if (flag_gauss) {
+        float sigma = 1.5*r;
+        // Loop over all the pixels in a big square window around the keypoint
+        for (int i = max(1,(int) (x-3*sigma)); i <= min((int) (x+3*sigma),nx-2); i++) {
+            for (int j = max(1,(int) (y-3*sigma)); j <= min((int) (y+3*sigma),ny-2); j++) {
+                // The contributing pixels are in a circle centered in (x,y)
+                if ((i-x)*(i-x)+(j-y)*(j-y) <= 9*sigma*sigma) {
+                    MODES_TALLY(visited);
+                    int gx = im[j*stride+i+1]-im[j*stride+i-1];
+                    int gy = -im[(j+1)*stride+i]+im[(j-1)*stride+i];
+
+                    if (flag_norm) {
+                        count++;
+                        histo.incr(lut.bin(gx,gy),lut.norm(gx,gy)*exp(-((i-x)*(i-x)+(j-y)*(j-y))/(2*sigma*sigma)));
+                    }
+
+                    else if (gx*gx+gy*gy > ac_n2) {
+                        count++;
+                        histo.incr(lut.bin(gx,gy),exp(-((i-x)*(i-x)+(j-y)*(j-y))/(2*sigma*sigma)));
+                    }
+                }
+            }
+        }
+    }
+
+    else {
+        // Loop over all the pixels in a square window around the keypoint
+        for (int i = max(1,(x-r)); i <= min((x+r),nx-2); i++) {
+            for (int j = max(1,(y-r)); j <= min((y+r),ny-2); j++) {
+                // The contributing pixels are in a circle centered in (x,y)
+                if ((i-x)*(i-x)+(j-y)*(j-y) <= r*r) {
+                    MODES_TALLY(visited);
+                    int gx = im[j*stride+i+1]-im[j*stride+i-1];
+                    int gy = -im[(j+1)*stride+i]+im[(j-1)*stride+i];
+
+                    if (flag_norm) {
+                        count++;
+                        histo.incr(lut.bin(gx,gy),lut.norm(gx,gy));
+                    }
+
+                    else if (gx*gx+gy*gy > ac_n2) {
+                        count++;
+                        histo.incr(lut.bin(gx,gy));
+                    }
+                }
+            }
+        }
+    }
+
+    // Normalization : the sum of the histogram has to be equal to the number of pixels contributing
+    if (histo.get_M() > 0)
+        histo *= count/histo.get_M();
+
+    MODES_COUNT(COUNT_PIXELS, visited);
+    if (!flag_norm)
+        MODES_COUNT(COUNT_PIXELS_THRESHOLD, count);
+    return histo;
+}
+
+
+// Gradient field of image im : norm and angle (in radians) of the gradient of
+// every pixel (i,j) with 1 <= i <= nx-2 and 1 <= j <= ny-2, stored in
+// norm[j*stride+i] and theta[j*stride+i], computed as in histo_orientation().
+// The other values are set to 0.
+template <typename T>
+void orientation_field(const T *im, int nx, int ny, size_t stride, float *norm, float *theta)
+{
+    MODES_STAGE(STAGE_GRADIENT);
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            if (i < 1 || i > nx-2 || j < 1 || j > ny-2) {
+                norm[j*stride+i] = theta[j*stride+i] = 0;
+                continue;
+            }
+            float gx = pixel_value(im[j*stride+i+1])-pixel_value(im[j*stride+i-1]);
+            float gy = -pixel_value(im[(j+1)*stride+i])+pixel_value(im[(j-1)*stride+i]);
+            norm[j*stride+i] = sqrtf(gx*gx+gy*gy);
+            theta[j*stride+i] = atan2f(gy,gx);
+        }
+    }
+}
+
+template void orientation_field(const float*, int, int, size_t, float*, float*);
+template void orientation_field(const unsigned char*, int, int, size_t, float*, float*);
+template void orientation_field(const be16*, int, int, size_t, float*, float*);
+
+
+// Gradient and norm of a line of a padded image, by the kernels of the
+// processor for the float and 8bit images
+template <typename T>
+static void gradient_line(const T *l, const T *up, const T *down, int n, float *gx, float *gy, float *norm)
+{
+    for (int i = 0; i < n; i++) {
+        gx[i] = pixel_value(l[i+1])-pixel_value(l[i-1]);
+        gy[i] = -pixel_value(down[i])+pixel_value(up[i]);
+        norm[i] = sqrtf(gx[i]*gx[i]+gy[i]*gy[i]);
+    }
+}
+
+static void gradient_line(const float *l, const float *up, const float *down, int n, float *gx, float *gy, float *norm)
+{
+    kernels().gradient_f32(l, up, down, n, gx, gy, norm);
+}
+
+static void gradient_line(const unsigned char *l, const unsigned char *up, const unsigned char *down, int n,
+                          float *gx, float *gy, float *norm)
+{
+    kernels().gradient_u8(l, up, down, n, gx, gy, norm);
+}
+
+
+// Same as orientation_field() on an image whose pixels have neighbours
+// outside of the image, such as a PaddedImage : the gradients of whole
+// lines are computed without any test, then the borders are cleared.
+template <typename T>
+void orientation_field_padded(const T *im, int nx, int ny, size_t stride, float *norm, float *theta)
+{
+    MODES_STAGE(STAGE_GRADIENT);
+    vector<float> gx(nx + 1), gy(nx + 1);
+    for (int j = 0; j < ny; j++) {
+        const T *l = im + j*stride;
+        float *t = theta + j*stride;
+        gradient_line(l, l - stride, l + stride, nx, &gx[0], &gy[0], norm + j*stride);
+        for (int i = 0; i < nx; i++)
+            t[i] = atan2f(gy[i],gx[i]);
+    }
+
+    // The pixels of the borders have no gradient
+    for (int i = 0; i < nx && ny > 0; i++) {
+        norm[i] = theta[i] = 0;
+        norm[(ny-1)*stride+i] = theta[(ny-1)*stride+i] = 0;
+    }
+    for (int j = 0; j < ny && nx > 0; j++) {
+        norm[j*stride] = theta[j*stride] = 0;
+        norm[j*stride+nx-1] = theta[j*stride+nx-1] = 0;
+    }
+}
+
+template void orientation_field_padded(const float*, int, int, size_t, float*, float*);
+template void orientation_field_padded(const unsigned char*, int, int, size_t, float*, float*);
+template void orientation_field_padded(const be16*, int, int, size_t, float*, float*);
+
+
+// Same as histo_orientation(), with the gradients read in the field computed
+// by orientation_field() instead of the image
+Histo histo_orientation_field(const float *norm, const float *theta, int nx, int ny, size_t stride, int x, int y, int r, int L, int flag_norm, int flag_gauss)
+{
+    MODES_STAGE(STAGE_HISTO);
+    Histo histo(L);
+    int count(0);
+    MODES_LOCAL_COUNTER(visited);
+
+    if (flag_gauss) {
+        float sigma = 1.5*r;
+        // Loop over all the pixels in a big square window around the keypoint
+        for (int i = max(1,(int) (x-3*sigma)); i <= min((int) (x+3*sigma),nx-2); i++) {
+            for (int j = max(1,(int) (y-3*sigma)); j <= min((int) (y+3*sigma),ny-2); j++) {
+                // The contributing pixels are in a circle centered in (x,y)
+                if ((i-x)*(i-x)+(j-y)*(j-y) <= 9*sigma*sigma) {
+                    MODES_TALLY(visited);
+                    float n = norm[j*stride+i];
+                    if (flag_norm || n > 3*sqrt(2)) {
+                        count++;
+                        int bin = floor((L/(2*M_PI))*(theta[j*stride+i]+M_PI+M_PI/L));
+                        if (bin == L) bin = 0;
+                        if (flag_norm)
+                            histo.incr(bin,n*exp(-((i-x)*(i-x)+(j-y)*(j-y))/(2*sigma*sigma)));
+                        else
+                            histo.incr(bin,exp(-((i-x)*(i-x)+(j-y)*(j-y))/(2*sigma*sigma)));
+                    }
+                }
+            }
+        }
+    }
+
+    else {
+        // Loop over all the pixels in a square window around the keypoint
+        for (int i = max(1,(x-r)); i <= min((x+r),nx-2); i++) {
+            for (int j = max(1,(y-r)); j <= min((y+r),ny-2); j++) {
+                // The contributing pixels are in a circle centered in (x,y)
+                if ((i-x)*(i-x)+(j-y)*(j-y) <= r*r) {
+                    MODES_TALLY(visited);
+                    float n = norm[j*stride+i];
+                    if (flag_norm || n > 3*sqrt(2)) {
+                        count++;
+                        int bin = floor((L/(2*M_PI))*(theta[j*stride+i]+M_PI+M_PI/L));
+                        if (bin == L) bin = 0;
+                        if (flag_norm)
+                            histo.incr(bin,n);
+                        else
+                            histo.incr(bin);
+                    }
+                }
+            }
+        }
+    }
+
+    // Normalization : the sum of the histogram has to be equal to the number of pixels contributing
+    if (histo.get_M() > 0)
+        histo *= count/histo.get_M();
+
+    MODES_COUNT(COUNT_PIXELS, visited);
+    if (!flag_norm)
+        MODES_COUNT(COUNT_PIXELS_THRESHOLD, count);
+    return histo;
+}
+
+// Same as histo_orientation() with flag_norm = 0 and flag_gauss = 0, in
+// integer counts : there is no normalization, the values being already the
+// numbers of pixels above the threshold
+template <typename C, typename T>
+CountHisto<C> histo_counts(const T *im, int nx, int ny, size_t stride, int x, int y, int r, int L)
+{
+    MODES_STAGE(STAGE_HISTO);
+    CountHisto<C> histo(L);
+    MODES_LOCAL_COUNTER(visited);
+
+    // Loop over all the pixels in a square window around the keypoint
+    for (int i = max(1,(x-r)); i <= min((x+r),nx-2); i++) {
+        for (int j = max(1,(y-r)); j <= min((y+r),ny-2); j++) {
+            // The contributing pixels are in a circle centered in (x,y)
+            if ((i-x)*(i-x)+(j-y)*(j-y) <= r*r) {
+                MODES_TALLY(visited);
+                float gx = pixel_value(im[j*stride+i+1])-pixel_value(im[j*stride+i-1]);
+                float gy = -pixel_value(im[(j+1)*stride+i])+pixel_value(im[(j-1)*stride+i]);
+                float norm = sqrtf(gx*gx+gy*gy);
+
+                if (norm > 3*sqrt(2)) {
+                    float theta = atan2f(gy,gx);
+                    int bin = floor((L/(2*M_PI))*(theta+M_PI+M_PI/L));
+                    // If theta=M_PI, we are in the bin number L which is the bin 0
+                    if (bin == L)
+                        bin = 0;
+                    histo.incr(bin);
+                }
+            }
+        }
+    }
+
+    MODES_COUNT(COUNT_PIXELS, visited);
+    MODES_COUNT(COUNT_PIXELS_THRESHOLD, histo.get_M());
+    return histo;
+}
+
+template CountHisto<uint16_t> histo_counts<uint16_t>(const float*, int, int, size_t, int, int, int, int);
+template CountHisto<uint16_t> histo_counts<uint16_t>(const unsigned char*, int, int, size_t, int, int, int, int);
+template CountHisto<uint16_t> histo_counts<uint16_t>(const be16*, int, int, size_t, int, int, int, int);
+template CountHisto<uint32_t> histo_counts<uint32_t>(const float*, int, int, size_t, int, int, int, int);
+template CountHisto<uint32_t> histo_counts<uint32_t>(const unsigned char*, int, int, size_t, int, int, int, int);
+template CountHisto<uint32_t> histo_counts<uint32_t>(const be16*, int, int, size_t, int, int, int, int);
+
+
+// Same as histo_orientation_lut() with flag_norm = 0 and flag_gauss = 0, in
+// integer counts
+template <typename C>
+CountHisto<C> histo_counts_lut(const unsigned char *im, int nx, int ny, size_t stride, int x, int y, int r, const OrientationLut &lut)
+{
+    MODES_STAGE(STAGE_HISTO);
+    CountHisto<C> histo(lut.get_L());
+    MODES_LOCAL_COUNTER(visited);
+    int ac_n2(lut.get_ac_n2());
+
+    // Loop over all the pixels in a square window around the keypoint
+    for (int i = max(1,(x-r)); i <= min((x+r),nx-2); i++) {
+        for (int j = max(1,(y-r)); j <= min((y+r),ny-2); j++) {
+            // The contributing pixels are in a circle centered in (x,y)
+            if ((i-x)*(i-x)+(j-y)*(j-y) <= r*r) {
+                MODES_TALLY(visited);
+                int gx = im[j*stride+i+1]-im[j*stride+i-1];
+                int gy = -im[(j+1)*stride+i]+im[(j-1)*stride+i];
+                if (gx*gx+gy*gy > ac_n2)
+                    histo.incr(lut.bin(gx,gy));
+            }
+        }
+    }
+
+    MODES_COUNT(COUNT_PIXELS, visited);
+    MODES_COUNT(COUNT_PIXELS_THRESHOLD, histo.get_M());
+    return histo;
+}
+
+template CountHisto<uint16_t> histo_counts_lut<uint16_t>(const unsigned char*, int, int, size_t, int, int, int, const OrientationLut&);
+template CountHisto<uint32_t> histo_counts_lut<uint32_t>(const unsigned char*, int, int, size_t, int, int, int, const OrientationLut&);
+
+
+// Same as histo_orientation_field() with flag_norm = 0 and flag_gauss = 0,
+// in integer counts
+template <typename C>
+CountHisto<C> histo_counts_field(const float *norm, const float *theta, int nx, int ny, size_t stride, int x, int y, int r, int L)
+{
+    MODES_STAGE(STAGE_HISTO);
+    CountHisto<C> histo(L);
+    MODES_LOCAL_COUNTER(visited);
+
+    // Loop over all the pixels in a square window around the keypoint
+    for (int i = max(1,(x-r)); i <= min((x+r),nx-2); i++) {
+        for (int j = max(1,(y-r)); j <= min((y+r),ny-2); j++) {
+            // The contributing pixels are in a circle centered in (x,y)
+            if ((i-x)*(i-x)+(j-y)*(j-y) <= r*r) {
+                MODES_TALLY(visited);
+                if (norm[j*stride+i] > 3*sqrt(2)) {
+                    int bin = floor((L/(2*M_PI))*(theta[j*stride+i]+M_PI+M_PI/L));
+                    if (bin == L) bin = 0;
+                    histo.incr(bin);
+                }
+            }
+        }
+    }
+
+    MODES_COUNT(COUNT_PIXELS, visited);
+    MODES_COUNT(COUNT_PIXELS_THRESHOLD, histo.get_M());
+    return histo;
+}
+
+template CountHisto<uint16_t> histo_counts_field<uint16_t>(const float*, const float*, int, int, size_t, int, int, int, int);
+template CountHisto<uint32_t> histo_counts_field<uint32_t>(const float*, const float*, int, int, size_t, int, int, int, int);
+
 
 // This is the principal function. It takes as an input the histogram histo, and
 // the parameter epsilon required by the a contrario model. It returns the list of
 // detected modes, concatenated. The list contains the entropy of each mode : if there
 // are two modes [a1,b1] and [a2,b2] with log_nfa values nfa1 and nfa2 the output is
-// the list [a1,b1,nfa1,a2,b2,nfa2]
-vector<float> max_modes_detection(Histo &histo, float epsilon)
+// the list [a1,b1,nfa1,a2,b2,nfa2]. The histogram is a Histo or a CountHisto.
+template <typename H>
+static vector<float> maximal_modes(H &histo, float epsilon)
 {
     // Returned list
     vector<float> list;
@@ -204,20 +551,56 @@ vector<float> max_modes_detection(Histo &histo, float epsilon)
                 }
             }
         }
+        MODES_COUNT(COUNT_MODES, list.size()/3);
 
         // Clear memory
         for (int i=0; i<L; i++) {
-            delete intervals[i];
-            delete entropy[i];
+            delete[] intervals[i];
+            delete[] entropy[i];
         }
 
-        delete intervals;
-        delete entropy;
+        delete[] intervals;
+        delete[] entropy;
 
     }
     return list;
 }
 
+vector<float> max_modes_detection(Histo &histo, float epsilon)
+{
+    return maximal_modes(histo, epsilon);
+}
+
+template <typename C>
+vector<float> max_modes_detection(CountHisto<C> &histo, float epsilon)
+{
+    return maximal_modes(histo, epsilon);
+}
+
+template vector<float> max_modes_detection(CountHisto<uint16_t>&, float);
+template vector<float> max_modes_detection(CountHisto<uint32_t>&, float);
+
+
+// Line a of the matrices of browse_intervals(), by the kernel of the
+// processor for the type of the histogram
+static void intervals_row(const Kernels &kernel, const Histo &histo, int M, float thresh, int a,
+                          int *intervals, float *entropy, float *r, float *p)
+{
+    kernel.intervals_row(histo.get_data(), histo.get_L(), M, thresh, a, intervals, entropy, r, p);
+}
+
+static void intervals_row(const Kernels &kernel, const CountHisto16 &histo, int M, float thresh, int a,
+                          int *intervals, float *entropy, float *r, float *p)
+{
+    kernel.intervals_row_u16(histo.get_data(), histo.get_L(), M, thresh, a, intervals, entropy, r, p);
+}
+
+static void intervals_row(const Kernels &kernel, const CountHisto32 &histo, int M, float thresh, int a,
+                          int *intervals, float *entropy, float *r, float *p)
+{
+    kernel.intervals_row_u32(histo.get_data(), histo.get_L(), M, thresh, a, intervals, entropy, r, p);
+}
+
 
 // Function running over all the circular intervals contained in [1,L],
 // computing if they are meaningful intervals or gaps, or if they are not.
@@ -226,41 +609,57 @@ vector<float> max_modes_detection(Histo &histo, float epsilon)
 // -meaningful interval : 2
 // -meaningful gap : -1
 // -neither meaningful interval or gap : 0
-void browse_intervals(Histo &histo, float epsilon, int **intervals, float **entropy)
+template <typename H>
+static void browse(H &histo, float epsilon, int **intervals, float **entropy)
 {
+    MODES_STAGE(STAGE_BROWSE);
     int L = histo.get_L();
     int M = histo.get_M();
     int N = histo.get_N();
     float thresh = log(N/epsilon)/M;
-
+    MODES_LOCAL_COUNTER(n_intervals);
+    MODES_LOCAL_COUNTER(n_gaps);
+
+    // For each interval [a,b], with k samples, r = k/M is compared to
+    // p = (1+b-a)/L if b>=a and (1+b-a+L)/L if b<a, and their entropy to the
+    // threshold. The lines a are computed by the kernel of the processor.
+    const Kernels &kernel = kernels();
+    vector<float> r(L + 1), p(L + 1);
     for (int a=0; a<L; a++) {
+        intervals_row(kernel, histo, M, thresh, a, intervals[a], entropy[a], &r[0], &p[0]);
         for (int b=0; b<L; b++) {
-            // Compute k,r,p,e
-            int k = histo.sum(a,b);
-            float r = (float) k/M;
-            float p = (1+b-a)/((float) L) + (b<a); // p is equal to (1+b-a)/L if b>=a and to (1+b-a+L)/L if b<a
-            float e = compute_entropy(r,p);
-
-            // Save the entropy value e
-            entropy[a][b] = e;
-
-            // Memorize if the interval [a,b] is a meaningful interval or gap
-            if (e>thresh) {
-                if (r>p)
-                    intervals[a][b] = 2;
-                else
-                    intervals[a][b] = -1;
-            } else
-                intervals[a][b] = 0;
+            if (intervals[a][b] == 2)
+                MODES_TALLY(n_intervals);
+            else if (intervals[a][b] == -1)
+                MODES_TALLY(n_gaps);
         }
     }
+
+    MODES_COUNT(COUNT_INTERVALS, L*L);
+    MODES_COUNT(COUNT_MEANINGFUL_INTERVALS, n_intervals);
+    MODES_COUNT(COUNT_MEANINGFUL_GAPS, n_gaps);
 }
 
+void browse_intervals(Histo &histo, float epsilon, int **intervals, float **entropy)
+{
+    browse(histo, epsilon, intervals, entropy);
+}
+
+template <typename C>
+void browse_intervals(CountHisto<C> &histo, float epsilon, int **intervals, float **entropy)
+{
+    browse(histo, epsilon, intervals, entropy);
+}
+
+template void browse_intervals(CountHisto<uint16_t>&, float, int**, float**);
+template void browse_intervals(CountHisto<uint32_t>&, float, int**, float**);
+
 
 // This function "propagates" the -1 values such that if an interval contains a gap, its
 // marker in the "intervals" matrix goes to -1
 void spread_gaps(int L, int **intervals)
 {
+    MODES_STAGE(STAGE_SPREAD);
     // loop over all the lines of the matrix intervals
     for (int a(0); a<L; a++) {
         // the loop over the columns is separated in two parts
@@ -289,6 +688,7 @@ void spread_gaps(int L, int **intervals)
 // mode (by putting the marker to 1)
 void discard_modes(int L, int **intervals, float **entropy)
 {
+    MODES_STAGE(STAGE_DISCARD);
     // loop over all the lines of the matrix intervals
     for (int a(0); a<L; a++) {
         // the loop over the columns is separated in two parts
@@ -370,7 +770,8 @@ float compute_entropy(float r, float p)
 
 // Function that compute the angle corresponding to a given mode [a,b]. This angle is
 // equal to the weighted average of the values in the mode [a,b] of the histogram h
-float compute_orientation(Histo &h, int a, int b)
+template <typename H>
+static float orientation(H &h, int a, int b)
 {
     double theta = 0.0;
     if (a <= b)
@@ -387,3 +788,17 @@ float compute_orientation(Histo &h, int a, int b)
     theta /= h.sum(a,b);
     return fmod(theta, 2*M_PI);
 }
+
+float compute_orientation(Histo &h, int a, int b)
+{
+    return orientation(h, a, b);
+}
+
+template <typename C>
+float compute_orientation(CountHisto<C> &h, int a, int b)
+{
+    return orientation(h, a, b);
+}
+
+template float compute_orientation(CountHisto<uint16_t>&, int, int);
+template float compute_orientation(CountHisto<uint32_t>&, int, int);
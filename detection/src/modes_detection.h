@@ -1,15 +1,54 @@
 #ifndef FUNCTIONS_H_INCLUDED
 #define FUNCTIONS_H_INCLUDED
 
-Histo histo_orientation(float *im, int nx, int ny, int x, int y, int r, int L, int flag_norm, int flag_gauss);
+#include <stddef.h>
+#include <vector>
 
+#include "CountHisto.h"
+#include "Histo.h"
+#include "orientation_lut.h"
+
+// The pixel of coordinates (i,j) is stored in im[j*stride+i]. Instantiated
+// for the pixel types of pixel.h.
+template <typename T>
+Histo histo_orientation(const T *im, int nx, int ny, size_t stride, int x, int y, int r, int L, int flag_norm, int flag_gauss);
+
+// Same histogram on a 8bit image, with the bins and norms of the table lut
+Histo histo_orientation_lut(const unsigned char *im, int nx, int ny, size_t stride, int x, int y, int r, const OrientationLut &lut, int flag_norm, int flag_gauss);
+
+// Norm and angle of the gradient of every pixel, and the same histogram
+// computed from them
+template <typename T>
+void orientation_field(const T *im, int nx, int ny, size_t stride, float *norm, float *theta);
+// Same field, reading the pixels around the image (see padded_image.h)
+template <typename T>
+void orientation_field_padded(const T *im, int nx, int ny, size_t stride, float *norm, float *theta);
+Histo histo_orientation_field(const float *norm, const float *theta, int nx, int ny, size_t stride, int x, int y, int r, int L, int flag_norm, int flag_gauss);
+
+// The a contrario histograms with flag_norm = 0 and flag_gauss = 0, as
+// counts of C bits (uint16_t or uint32_t), equal to the values of the
+// histograms above : histo_counts<C>(im,...)
+template <typename C, typename T>
+CountHisto<C> histo_counts(const T *im, int nx, int ny, size_t stride, int x, int y, int r, int L);
+template <typename C>
+CountHisto<C> histo_counts_lut(const unsigned char *im, int nx, int ny, size_t stride, int x, int y, int r, const OrientationLut &lut);
+template <typename C>
+CountHisto<C> histo_counts_field(const float *norm, const float *theta, int nx, int ny, size_t stride, int x, int y, int r, int L);
+
+// The detection of the modes, on a Histo or on the counts of a CountHisto
 std::vector<float> max_modes_detection(Histo &h, float epsilon);
+template <typename C>
+std::vector<float> max_modes_detection(CountHisto<C> &h, float epsilon);
 
 void browse_intervals(Histo &histo, float epsilon, int **intervals, float **entropy);
+template <typename C>
+void browse_intervals(CountHisto<C> &histo, float epsilon, int **intervals, float **entropy);
 void spread_gaps(int L, int **intervals);
 void discard_modes(int L, int **intervals, float **entropy);
 
 float compute_entropy(float r, float p);
 float compute_orientation(Histo &h, int a, int b);
+template <typename C>
+float compute_orientation(CountHisto<C> &h, int a, int b);
 
 #endif // FUNCTIONS_H_INCLUDED
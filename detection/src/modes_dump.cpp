@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+using namespace std;
+
+#include "keypoint.h"
+#include "result_io.h"
+#include "column_store.h"
+
+// List the keypoints of a column store, reading the mapped columns
+static int list_columns(const char *dirname)
+{
+    ColumnReader reader;
+    if (!reader.open(dirname)) {
+        cerr << "unable to read the column store " << dirname << endl;
+        return 1;
+    }
+
+    uint64_t n(0), n_start(0);
+    const int32_t *x = (const int32_t *) reader.map("x", &n);
+    const int32_t *y = (const int32_t *) reader.map("y");
+    const int32_t *r = (const int32_t *) reader.map("r");
+    const int32_t *nb_pixels = (const int32_t *) reader.map("nb_pixels");
+    const uint64_t *mode_start = (const uint64_t *) reader.map("mode_start", &n_start);
+    const uint64_t *peak_start = (const uint64_t *) reader.map("peak_start");
+    if (x && n == 0)
+        return 0;
+    if (!x || !y || !r || !nb_pixels || !mode_start || !peak_start || n_start != n+1) {
+        cerr << "incomplete column store " << dirname << endl;
+        return 1;
+    }
+
+    for (uint64_t k(0); k < n; k++)
+        cout << k << " : " << x[k] << " " << y[k] << " " << r[k] << " ; "
+             << nb_pixels[k] << " pixels ; " << mode_start[k+1]-mode_start[k] << " modes ; "
+             << peak_start[k+1]-peak_start[k] << " peaks" << endl;
+    return 0;
+}
+
+// Conversion of a binary result stream written by modes_detection -o into
+// the text files of the single keypoint mode, for debugging.
+int main(int c, char *v[])
+{
+    if (c == 3 && strcmp(v[1], "-c") == 0)
+        return list_columns(v[2]);
+
+    bool list = (c > 1 && strcmp(v[1], "-l") == 0);
+    if (c < 2 + list) {
+        cout << "usage: " << v[0] << " results.bin [index]" << endl;
+        cout << "       " << v[0] << " -l results.bin" << endl;
+        cout << "       " << v[0] << " -c dir" << endl;
+        cout << "The first form writes the text files of the keypoint number index" << endl;
+        cout << "(default 0), the other ones list all the keypoints of a binary" << endl;
+        cout << "stream or of a column store." << endl;
+        return 1;
+    }
+
+    const char *fname = v[1 + list];
+    long index = (!list && c > 2) ? atol(v[2]) : 0;
+
+    ResultReader reader;
+    if (!reader.open(fname)) {
+        cerr << "unable to read " << fname << endl;
+        return 1;
+    }
+
+    Keypoint kp;
+    KeypointResult res;
+    for (long k(0); reader.read(kp, res); k++) {
+        if (list) {
+            cout << k << " : " << kp.x << " " << kp.y << " " << kp.r << " ; "
+                 << res.nb_pixels << " pixels ; " << res.modes.size() << " modes ; "
+                 << res.peaks.size() << " peaks" << endl;
+        } else if (k == index) {
+            write_text_results(res, reader.get_L());
+            if (!reader.has_histos())
+                cerr << "no histograms in " << fname << endl;
+            return 0;
+        }
+    }
+
+    if (reader.failed()) {
+        cerr << "truncated or corrupt stream " << fname << endl;
+        return 1;
+    }
+    if (!list) {
+        cerr << "no keypoint number " << index << " in " << fname << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <math.h>
+#include <vector>
+
+#include "orientation_lut.h"
+
+using namespace std;
+
+
+// The entries are computed exactly as in histo_orientation() : the gradient
+// components are floats holding integer values.
+OrientationLut::OrientationLut(int L) : m_L(L), m_ac_n2(0), m_bin(SIZE*SIZE), m_norm(SIZE*SIZE)
+{
+    for (int l = -RANGE; l <= RANGE; l++) {
+        for (int k = -RANGE; k <= RANGE; k++) {
+            float gx = k;
+            float gy = l;
+            float theta = atan2f(gy,gx);
+            int bin = floor((L/(2*M_PI))*(theta+M_PI+M_PI/L));
+            // If theta=M_PI, we are in the bin number L which is the bin 0
+            if (bin == L) bin = 0;
+
+            m_bin[(l+RANGE)*SIZE+k+RANGE] = bin;
+            m_norm[(l+RANGE)*SIZE+k+RANGE] = sqrtf(gx*gx+gy*gy);
+        }
+    }
+
+    // Integer form of the a contrario threshold norm > 3*sqrt(2) : the
+    // largest squared norm that does not pass it
+    while (sqrtf((float) (m_ac_n2+1)) <= 3*sqrt(2))
+        m_ac_n2++;
+}
+
+int OrientationLut::get_L() const
+{
+    return m_L;
+}
+
+int OrientationLut::get_ac_n2() const
+{
+    return m_ac_n2;
+}
@@ -0,0 +1,44 @@
+#ifndef ORIENTATION_LUT_H_INCLUDED
+#define ORIENTATION_LUT_H_INCLUDED
+
+#include <vector>
+
+/**
+* Orientation bin and norm of every gradient (gx,gy) of a 8bit image, for a
+* histogram of L bins. The central differences of 8bit pixels are integers
+* in [-255,255], the table has 511x511 entries computed with the same float
+* formulas as histo_orientation(), hence the results are identical.
+*/
+class OrientationLut
+{
+public :
+
+    /**
+    * Constructor
+    */
+    OrientationLut(int L);
+
+    /**
+    * Accessors
+    */
+    int get_L() const;
+    int get_ac_n2() const;
+    int bin(int gx, int gy) const {
+        return m_bin[(gy+RANGE)*SIZE+gx+RANGE];
+    };
+    float norm(int gx, int gy) const {
+        return m_norm[(gy+RANGE)*SIZE+gx+RANGE];
+    };
+
+    static const int RANGE = 255; // largest absolute value of a gradient component
+    static const int SIZE = 2*RANGE+1;
+
+private :
+
+    int m_L; // number of bins
+    int m_ac_n2; // a gradient counts in the a contrario histogram iff gx*gx+gy*gy > m_ac_n2
+    std::vector<unsigned short> m_bin;
+    std::vector<float> m_norm;
+};
+
+#endif // ORIENTATION_LUT_H_INCLUDED
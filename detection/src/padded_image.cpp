@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <string.h>
+
+#include "io_png.h"
+#include "instrument.h"
+#include "pixel.h"
+#include "tiled_image.h"
+#include "padded_image.h"
+
+
+// Decoding in the caller array with the reader, for each pixel type
+static int read_gray(PngReader &reader, const char *fname, size_t *nx, size_t *ny, size_t y0, size_t y1,
+                     float *out, size_t stride, size_t capacity)
+{
+    return reader.read_f32_gray(fname, nx, ny, y0, y1, out, stride, capacity);
+}
+
+static int read_gray(PngReader &reader, const char *fname, size_t *nx, size_t *ny, size_t y0, size_t y1,
+                     unsigned char *out, size_t stride, size_t capacity)
+{
+    return reader.read_u8_gray(fname, nx, ny, y0, y1, out, stride, capacity);
+}
+
+static float *read_gray(PngReader &reader, const char *fname, size_t *nx, size_t *ny, size_t y0, size_t y1,
+                        float *)
+{
+    return reader.read_f32_gray(fname, nx, ny, y0, y1);
+}
+
+static unsigned char *read_gray(PngReader &reader, const char *fname, size_t *nx, size_t *ny, size_t y0, size_t y1,
+                                unsigned char *)
+{
+    return reader.read_u8_gray(fname, nx, ny, y0, y1);
+}
+
+
+// The size of the image is read first, to decode it directly in the padded
+// layout. The standard input can only be read once : it is decoded in the
+// buffer of the reader, then copied.
+template <typename T>
+static bool load_png(PngReader &reader, const char *fname, size_t &nx, size_t &ny, size_t &y0, size_t &y1,
+                     PaddedImage<T> &im, size_t apron)
+{
+    MODES_STAGE(STAGE_DECODE);
+    if (strcmp(fname, "-") == 0) {
+        const T *band = read_gray(reader, fname, &nx, &ny, y0, y1, (T *) NULL);
+        if (!band)
+            return false;
+        y1 = y1 < ny ? y1 : ny;
+        y0 = y0 < y1 ? y0 : y1;
+        if (!im.allocate(nx, y1 - y0, apron))
+            return false;
+        for (size_t j(0); j < y1 - y0; j++)
+            memcpy(im.line(j), band + j * nx, nx * sizeof(T));
+    } else {
+        if (read_png_size(fname, &nx, &ny) != 0)
+            return false;
+        y1 = y1 < ny ? y1 : ny;
+        y0 = y0 < y1 ? y0 : y1;
+        if (!im.allocate(nx, y1 - y0, apron))
+            return false;
+        size_t capacity = (y1 - y0) * im.get_stride();
+        if (read_gray(reader, fname, &nx, &ny, y0, y1, im.get_data(), im.get_stride(), capacity) != 0
+            || nx != im.get_nx())
+            return false;
+    }
+    im.replicate_border();
+    return true;
+}
+
+bool load_png_rows(PngReader &reader, const char *fname, size_t &nx, size_t &ny, size_t &y0, size_t &y1,
+                   PaddedImage<float> &im, size_t apron)
+{
+    return load_png(reader, fname, nx, ny, y0, y1, im, apron);
+}
+
+bool load_png_rows(PngReader &reader, const char *fname, size_t &nx, size_t &ny, size_t &y0, size_t &y1,
+                   PaddedImage<unsigned char> &im, size_t apron)
+{
+    return load_png(reader, fname, nx, ny, y0, y1, im, apron);
+}
+
+
+template <typename T>
+bool load_window(TiledImage &tiled, size_t x0, size_t y0, size_t x1, size_t y1,
+                 PaddedImage<T> &im, size_t apron)
+{
+    MODES_STAGE(STAGE_DECODE);
+    if (pixel_size(tiled.get_type()) != sizeof(T) || x0 > x1 || y0 > y1)
+        return false;
+    if (!im.allocate(x1 - x0, y1 - y0, apron)
+        || !tiled.read_window(x0, y0, x1, y1, im.get_data(), im.get_stride()))
+        return false;
+    im.replicate_border();
+    return true;
+}
+
+template bool load_window(TiledImage&, size_t, size_t, size_t, size_t, PaddedImage<float>&, size_t);
+template bool load_window(TiledImage&, size_t, size_t, size_t, size_t, PaddedImage<unsigned char>&, size_t);
+template bool load_window(TiledImage&, size_t, size_t, size_t, size_t, PaddedImage<be16>&, size_t);
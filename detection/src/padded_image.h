@@ -0,0 +1,113 @@
+#ifndef PADDED_IMAGE_H_INCLUDED
+#define PADDED_IMAGE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io_png.h"
+#include "tiled_image.h"
+
+// Alignment, in bytes, of the first pixel of every line of a PaddedImage
+#define PADDED_ALIGN 64
+// Default width, in pixels, of the apron around a PaddedImage
+#define PADDED_APRON 4
+
+/**
+* Image of nx x ny pixels surrounded by an apron of pixels on each side,
+* filled by replicate_border() with the nearest pixel of the image. The first
+* pixel of every line is aligned on PADDED_ALIGN bytes, and the lines are
+* stride pixels apart, a multiple of PADDED_ALIGN bytes. A kernel can thus
+* read the pixels up to the apron around any pixel of the image without any
+* test, and process whole aligned vectors of a line. The pixel (i,j) is
+* get_data()[j*get_stride()+i], as with the other images.
+*/
+template <typename T>
+class PaddedImage
+{
+public :
+    PaddedImage() : m_buf(NULL), m_size(0), m_data(NULL), m_nx(0), m_ny(0), m_apron(0), m_stride(0) {}
+    ~PaddedImage() { free(m_buf); }
+
+    // Layout of an image of nx x ny pixels, with lines of at least
+    // min_stride pixels. The buffer is only reallocated if it is too small,
+    // the previous pixels are lost.
+    bool allocate(size_t nx, size_t ny, size_t apron = PADDED_APRON, size_t min_stride = 0)
+    {
+        const size_t block = PADDED_ALIGN / sizeof(T);
+        size_t lead = (apron + block - 1) / block * block;
+        size_t stride = nx + 2 * apron > min_stride ? nx + 2 * apron : min_stride;
+        stride = (stride + block - 1) / block * block;
+        size_t size = (lead + (ny + 2 * apron) * stride) * sizeof(T);
+        if (size > m_size) {
+            void *buf;
+            if (posix_memalign(&buf, PADDED_ALIGN, size) != 0)
+                return false;
+            free(m_buf);
+            m_buf = (T *) buf;
+            m_size = size;
+        }
+        m_data = m_buf + lead + apron * stride;
+        m_nx = nx;
+        m_ny = ny;
+        m_apron = apron;
+        m_stride = stride;
+        return true;
+    }
+
+    // Copy the pixels of the borders of the image to the apron
+    void replicate_border()
+    {
+        if (m_nx == 0 || m_ny == 0)
+            return;
+        for (size_t j(0); j < m_ny; j++) {
+            T *l = line(j);
+            for (size_t k(1); k <= m_apron; k++) {
+                l[-(ptrdiff_t) k] = l[0];
+                l[m_nx - 1 + k] = l[m_nx - 1];
+            }
+        }
+        size_t w = (m_nx + 2 * m_apron) * sizeof(T);
+        for (size_t k(1); k <= m_apron; k++) {
+            memcpy(line(-(ptrdiff_t) k) - m_apron, line(0) - m_apron, w);
+            memcpy(line(m_ny - 1 + k) - m_apron, line(m_ny - 1) - m_apron, w);
+        }
+    }
+
+    T *get_data() { return m_data; }
+    const T *get_data() const { return m_data; }
+    size_t get_nx() const { return m_nx; }
+    size_t get_ny() const { return m_ny; }
+    size_t get_apron() const { return m_apron; }
+    size_t get_stride() const { return m_stride; } // in pixels
+
+    // First pixel of the line j, from -apron to ny-1+apron
+    T *line(ptrdiff_t j) { return m_data + j * (ptrdiff_t) m_stride; }
+
+private :
+    PaddedImage(const PaddedImage&);
+    PaddedImage& operator=(const PaddedImage&);
+
+    T *m_buf;
+    size_t m_size; // in bytes
+    T *m_data; // pixel (0,0)
+    size_t m_nx;
+    size_t m_ny;
+    size_t m_apron;
+    size_t m_stride;
+};
+
+// Band of lines [y0,y1) of a PNG image converted to gray, decoded directly in
+// the padded layout. nx, ny get the size of the whole image, and y0, y1 are
+// bounded by ny.
+bool load_png_rows(PngReader &reader, const char *fname, size_t &nx, size_t &ny, size_t &y0, size_t &y1,
+                   PaddedImage<float> &im, size_t apron = PADDED_APRON);
+bool load_png_rows(PngReader &reader, const char *fname, size_t &nx, size_t &ny, size_t &y0, size_t &y1,
+                   PaddedImage<unsigned char> &im, size_t apron = PADDED_APRON);
+
+// Window [x0,x1)x[y0,y1) of a tiled image whose pixels are of type T
+template <typename T>
+bool load_window(TiledImage &tiled, size_t x0, size_t y0, size_t x1, size_t y1,
+                 PaddedImage<T> &im, size_t apron = PADDED_APRON);
+
+#endif // PADDED_IMAGE_H_INCLUDED
@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "io_png.h"
+#include "keypoint.h"
+#include "modes_detection.h"
+#include "planner.h"
+#include "padded_image.h"
+#include "result_io.h"
+#include "work_queue.h"
+#include "pipeline.h"
+
+using namespace std;
+
+// Image going through the stages : the band [y0,y0+ny) of the image,
+// and its gradient field if the planner chooses it
+struct PipelineItem
+{
+    size_t job;
+    vector<Keypoint> kps;
+    PaddedImage<float> im;
+    size_t nx;
+    size_t ny;
+    size_t y0;
+    vector<float> norm;
+    vector<float> theta;
+};
+
+// State shared by all the threads of a run
+struct PipelineState
+{
+    const vector<PipelineJob> *jobs;
+    int n_bins;
+    int flag_norm;
+    float epsilon;
+    bool with_histos;
+    const Planner *planner;
+    WorkQueue<size_t> *todo;
+    WorkQueue<PipelineItem*> *decoded;
+    WorkQueue<PipelineItem*> *ready;
+    pthread_mutex_t mutex; // protects failures
+    size_t failures;
+};
+
+static void job_failed(PipelineState *st, size_t job, const char *msg)
+{
+    pthread_mutex_lock(&st->mutex);
+    fprintf(stderr, "%s: %s\n", (*st->jobs)[job].image.c_str(), msg);
+    st->failures++;
+    pthread_mutex_unlock(&st->mutex);
+}
+
+
+// Decoding stage : keypoints, then the band of lines they need
+static void *decode_stage(void *arg)
+{
+    PipelineState *st = (PipelineState *) arg;
+    PngReader reader;
+    size_t job(0);
+    while (st->todo->pop(job)) {
+        PipelineItem *item = new PipelineItem;
+        item->job = job;
+        if (!read_keypoints((*st->jobs)[job].keypoints.c_str(), item->kps)) {
+            job_failed(st, job, "unable to read the keypoints");
+            delete item;
+            continue;
+        }
+
+        size_t y0, y1, ny;
+        keypoints_rows(item->kps, INT_MAX, y0, y1);
+        if (!load_png_rows(reader, (*st->jobs)[job].image.c_str(), item->nx, ny, y0, y1, item->im)) {
+            job_failed(st, job, "unable to read the image");
+            delete item;
+            continue;
+        }
+        item->y0 = y0;
+        item->ny = y1 - y0;
+        st->decoded->push(item);
+    }
+    st->decoded->producer_done();
+    return NULL;
+}
+
+
+// Gradient stage : gradient field of the band, if it is chosen by the planner
+static void *gradient_stage(void *arg)
+{
+    PipelineState *st = (PipelineState *) arg;
+    PipelineItem *item;
+    while (st->decoded->pop(item)) {
+        if (st->planner->plan(item->kps, 0, item->y0, item->nx, item->ny, false) == STRATEGY_FIELD) {
+            size_t stride = item->im.get_stride();
+            item->norm.resize(stride * item->ny + 1);
+            item->theta.resize(stride * item->ny + 1);
+            orientation_field_padded(item->im.get_data(), item->nx, item->ny, stride,
+                                     &item->norm[0], &item->theta[0]);
+        }
+        st->ready->push(item);
+    }
+    st->ready->producer_done();
+    return NULL;
+}
+
+
+// Detection of the keypoints of an item, written in its stream
+class ItemTask : public KeypointTask
+{
+public :
+    ItemTask(const PipelineState *st, const PipelineItem *item, ResultWriter &writer)
+        : m_st(st), m_item(item), m_writer(writer)
+    {
+    }
+
+    void detect(const Keypoint &kp, KeypointResult &res)
+    {
+        const PipelineItem *item = m_item;
+        size_t stride = item->im.get_stride();
+        if (!item->norm.empty())
+            detect_keypoint_field(&item->norm[0], &item->theta[0], item->nx, item->ny, stride,
+                                  kp.x, kp.y-(int)item->y0, kp.r, m_st->n_bins, m_st->flag_norm,
+                                  m_st->epsilon, m_st->with_histos, res);
+        else
+            detect_keypoint(item->im.get_data(), item->nx, item->ny, stride,
+                            kp.x, kp.y-(int)item->y0, kp.r, m_st->n_bins, m_st->flag_norm,
+                            m_st->epsilon, m_st->with_histos, res);
+    }
+
+    bool write(const Keypoint &kp, const KeypointResult &res)
+    {
+        return m_writer.write(kp, res);
+    }
+
+private :
+    const PipelineState *m_st;
+    const PipelineItem *m_item;
+    ResultWriter &m_writer;
+};
+
+
+// Detection stage : all the keypoints of an image, written in its stream
+static void *detect_stage(void *arg)
+{
+    PipelineState *st = (PipelineState *) arg;
+    PipelineItem *item;
+    while (st->ready->pop(item)) {
+        const PipelineJob &job = (*st->jobs)[item->job];
+        ResultWriter writer;
+        ItemTask task(st, item, writer);
+        bool ok = writer.open(job.output.c_str(), st->n_bins, st->with_histos)
+                  && detect_scheduled(item->kps, task);
+        ok = writer.close() && ok;
+        if (!ok)
+            job_failed(st, item->job, "unable to write the results");
+
+        delete item;
+    }
+    return NULL;
+}
+
+
+bool read_jobs(const char *fname, vector<PipelineJob> &jobs)
+{
+    ifstream f(fname);
+    if (!f)
+        return false;
+    PipelineJob job;
+    while (f >> job.image >> job.keypoints >> job.output)
+        jobs.push_back(job);
+    return f.eof();
+}
+
+
+// Run the three stages, each one with its threads, connected by queues
+// holding at most as many images as the threads of the next stage. The
+// decoding of the next images overlaps the processing of the previous ones,
+// and at most decode + 2*gradient + 2*detect images are in memory.
+bool run_pipeline(const vector<PipelineJob> &jobs, int n_bins, int flag_norm, float epsilon,
+                  bool with_histos, const Planner &planner, const PipelineThreads &threads)
+{
+    int nd = max(1, threads.decode), ng = max(1, threads.gradient), nt = max(1, threads.detect);
+    WorkQueue<size_t> todo(jobs.size(), 1);
+    WorkQueue<PipelineItem*> decoded(ng, nd);
+    WorkQueue<PipelineItem*> ready(nt, ng);
+    for (size_t k(0); k < jobs.size(); k++)
+        todo.push(k);
+    todo.producer_done();
+
+    PipelineState st;
+    st.jobs = &jobs;
+    st.n_bins = n_bins;
+    st.flag_norm = flag_norm;
+    st.epsilon = epsilon;
+    st.with_histos = with_histos;
+    st.planner = &planner;
+    st.todo = &todo;
+    st.decoded = &decoded;
+    st.ready = &ready;
+    pthread_mutex_init(&st.mutex, NULL);
+    st.failures = 0;
+
+    // The stages are started from the last one, so that the threads of a
+    // stage always have their consumers
+    vector<pthread_t> tids(nt + ng + nd);
+    int started(0);
+    for (; started < nt + ng + nd; started++) {
+        int k = started;
+        void *(*stage)(void *) = k < nt ? detect_stage : (k < nt + ng ? gradient_stage : decode_stage);
+        if (pthread_create(&tids[k], NULL, stage, &st) != 0)
+            break;
+    }
+
+    // Without all its threads, the pipeline is stopped : no new image is
+    // decoded, and the queues are ended for the threads that do not exist,
+    // so that the images in progress go through the threads started
+    bool complete = (started == nt + ng + nd);
+    if (!complete) {
+        fprintf(stderr, "unable to create the threads of the pipeline\n");
+        todo.close();
+        for (int k(max(0, started - nt - ng)); k < nd; k++)
+            decoded.producer_done();
+        for (int k(max(0, started - nt)); k < ng; k++)
+            ready.producer_done();
+    }
+    for (int k(0); k < started; k++)
+        pthread_join(tids[k], NULL);
+
+    pthread_mutex_destroy(&st.mutex);
+    return complete && st.failures == 0;
+}
@@ -0,0 +1,38 @@
+#ifndef PIPELINE_H_INCLUDED
+#define PIPELINE_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "planner.h"
+
+/**
+* One image of a pipeline run : its keypoints are read from a "x y r" text
+* file, and its results are written in a binary result stream
+*/
+struct PipelineJob
+{
+    std::string image;
+    std::string keypoints;
+    std::string output;
+};
+
+/**
+* Number of threads of each stage : PNG decoding, gradient field
+* computation (only for the images where the planner chooses it), and
+* detection
+*/
+struct PipelineThreads
+{
+    int decode;
+    int gradient;
+    int detect;
+};
+
+// Jobs given as "image keypoints output" lines
+bool read_jobs(const char *fname, std::vector<PipelineJob> &jobs);
+
+bool run_pipeline(const std::vector<PipelineJob> &jobs, int n_bins, int flag_norm, float epsilon,
+                  bool with_histos, const Planner &planner, const PipelineThreads &threads);
+
+#endif // PIPELINE_H_INCLUDED
@@ -0,0 +1,30 @@
+#ifndef PIXEL_H_INCLUDED
+#define PIXEL_H_INCLUDED
+
+/**
+* Pixel types of the images that can be processed in place. The value of
+* any pixel is read as a float with pixel_value().
+*/
+
+// Big-endian 16bit sample, as stored in 16bit PGM files
+struct be16
+{
+    unsigned char b[2];
+};
+
+inline float pixel_value(float v)
+{
+    return v;
+}
+
+inline float pixel_value(unsigned char v)
+{
+    return v;
+}
+
+inline float pixel_value(be16 v)
+{
+    return (v.b[0] << 8) | v.b[1];
+}
+
+#endif // PIXEL_H_INCLUDED
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "keypoint.h"
+#include "orientation_lut.h"
+#include "planner.h"
+
+using namespace std;
+
+// Time per pixel, in nanoseconds, of the loops of the two histograms of a
+// keypoint (by pixel of their square windows) with each strategy, and of
+// orientation_field() and of the OrientationLut constructor (by entry).
+// Measured on a x86-64 core with -O3, only their ratios matter.
+#define COST_DIRECT 62.
+#define COST_FIELD 23.
+#define COST_LUT 20.
+#define COST_FIELD_BUILD 47.
+#define COST_LUT_BUILD 50.
+
+// Largest gradient field chosen automatically (two floats per pixel)
+#define FIELD_MEMORY ((size_t) 1 << 30)
+
+
+static const char *const strategy_names[N_STRATEGIES] = {"auto", "direct", "field", "lut"};
+
+const char *strategy_name(Strategy s)
+{
+    return strategy_names[s];
+}
+
+bool parse_strategy(const char *name, Strategy &s)
+{
+    for (int k(0); k < N_STRATEGIES; k++)
+        if (!strcmp(name, strategy_names[k])) {
+            s = (Strategy) k;
+            return true;
+        }
+    return false;
+}
+
+
+Planner::Planner(int L, Strategy forced, bool verbose) : m_L(L), m_forced(forced), m_verbose(verbose), m_lut(NULL)
+{
+}
+
+Planner::~Planner()
+{
+    delete m_lut;
+}
+
+const OrientationLut *Planner::get_lut()
+{
+    if (!m_lut)
+        m_lut = new OrientationLut(m_L);
+    return m_lut;
+}
+
+
+// Number of coordinates c-h..c+h read by the loops of histo_orientation() in
+// a window of n pixels, whose first and last pixels have no gradient
+static double clipped_span(long c, long h, long n)
+{
+    return max(0L, min(c + h, n - 2) - max(c - h, 1L) + 1);
+}
+
+
+void Planner::estimate(const vector<Keypoint> &kps, size_t x0, size_t y0, size_t nx, size_t ny, bool u8,
+                       double cost[N_STRATEGIES]) const
+{
+    // Pixels of the square windows of the two histograms of every keypoint
+    double pixels(0);
+    for (size_t k(0); k < kps.size(); k++) {
+        long x = kps[k].x - (long) x0, y = kps[k].y - (long) y0, r = kps[k].r;
+        long s = (long) (4.5 * r);
+        pixels += clipped_span(x, r, nx) * clipped_span(y, r, ny);
+        pixels += clipped_span(x, s, nx) * clipped_span(y, s, ny);
+    }
+
+    // The field only covers the pixels read by the keypoints
+    size_t wx0, wy0, wx1, wy1;
+    keypoints_window(kps, x0, y0, nx, ny, wx0, wy0, wx1, wy1);
+    double area = (double) (wx1 - wx0) * (wy1 - wy0);
+
+    cost[STRATEGY_AUTO] = -1;
+    cost[STRATEGY_DIRECT] = COST_DIRECT * pixels;
+    cost[STRATEGY_FIELD] = COST_FIELD_BUILD * area + COST_FIELD * pixels;
+    cost[STRATEGY_LUT] = -1;
+    if (u8)
+        cost[STRATEGY_LUT] = (m_lut ? 0 : COST_LUT_BUILD * OrientationLut::SIZE * OrientationLut::SIZE)
+            + COST_LUT * pixels;
+    if (m_forced != STRATEGY_FIELD && 2 * sizeof(float) * area > FIELD_MEMORY)
+        cost[STRATEGY_FIELD] = -1;
+}
+
+
+Strategy Planner::plan(const vector<Keypoint> &kps, size_t x0, size_t y0, size_t nx, size_t ny, bool u8) const
+{
+    double cost[N_STRATEGIES];
+    estimate(kps, x0, y0, nx, ny, u8, cost);
+
+    Strategy s = STRATEGY_DIRECT;
+    if (m_forced != STRATEGY_AUTO) {
+        // The table is only for 8bit images
+        if (cost[m_forced] >= 0)
+            s = m_forced;
+    } else {
+        for (int k(STRATEGY_DIRECT); k < N_STRATEGIES; k++)
+            if (cost[k] >= 0 && cost[k] < cost[s])
+                s = (Strategy) k;
+    }
+
+    if (m_verbose) {
+        char costs[N_STRATEGIES][32];
+        for (int k(STRATEGY_DIRECT); k < N_STRATEGIES; k++) {
+            if (cost[k] < 0)
+                strcpy(costs[k], "-");
+            else
+                sprintf(costs[k], "%.1f ms", cost[k] * 1e-6);
+        }
+        fprintf(stderr, "plan: %s%s for %lu keypoints on %lux%lu pixels (direct %s, field %s, lut %s)\n",
+                strategy_name(s), m_forced == STRATEGY_AUTO ? "" : (s == m_forced ? " (forced)" : " (forced one unavailable)"),
+                (unsigned long) kps.size(), (unsigned long) nx, (unsigned long) ny,
+                costs[STRATEGY_DIRECT], costs[STRATEGY_FIELD], costs[STRATEGY_LUT]);
+    }
+    return s;
+}
@@ -0,0 +1,66 @@
+#ifndef PLANNER_H_INCLUDED
+#define PLANNER_H_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+
+#include "keypoint.h"
+#include "orientation_lut.h"
+
+/**
+* Ways of building the histograms of a set of keypoints : the gradients of
+* each window computed by histo_orientation() (direct), the gradient field of
+* the pixels read by the keypoints computed once (field), or the gradients of
+* a 8bit image binned with an OrientationLut (lut). They give the same results.
+*/
+enum Strategy
+{
+    STRATEGY_AUTO,
+    STRATEGY_DIRECT,
+    STRATEGY_FIELD,
+    STRATEGY_LUT,
+    N_STRATEGIES
+};
+
+const char *strategy_name(Strategy s);
+bool parse_strategy(const char *name, Strategy &s);
+
+/**
+* Choice of the strategy of each image (or band, or window of a tile), from
+* the estimated time of each strategy : the number of pixels read by the
+* keypoints, and the number of pixels of their field, weighted by the time
+* per pixel measured for each loop. The strategy can be forced, and the
+* choices logged to stderr. plan() can be called by concurrent threads.
+*/
+class Planner
+{
+public :
+    Planner(int L, Strategy forced = STRATEGY_AUTO, bool verbose = false);
+    ~Planner();
+
+    // Strategy for the keypoints kps of the window of nx x ny pixels starting
+    // at (x0,y0), of a 8bit image if u8 is set
+    Strategy plan(const std::vector<Keypoint> &kps, size_t x0, size_t y0, size_t nx, size_t ny, bool u8) const;
+
+    // Estimated time of each strategy in nanoseconds, negative if the
+    // strategy is not available
+    void estimate(const std::vector<Keypoint> &kps, size_t x0, size_t y0, size_t nx, size_t ny, bool u8,
+                  double cost[N_STRATEGIES]) const;
+
+    int get_L() const { return m_L; }
+    Strategy get_forced() const { return m_forced; }
+
+    // The table of the 8bit gradients, built by the first call
+    const OrientationLut *get_lut();
+
+private :
+    Planner(const Planner&);
+    Planner& operator=(const Planner&);
+
+    int m_L; // number of bins
+    Strategy m_forced; // STRATEGY_AUTO to choose
+    bool m_verbose;
+    OrientationLut *m_lut;
+};
+
+#endif // PLANNER_H_INCLUDED
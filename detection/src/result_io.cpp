@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include "keypoint.h"
+#include "result_io.h"
+
+using namespace std;
+
+#define RESULT_MAGIC "MODESRES"
+#define RESULT_BUFFER_SIZE (1 << 20)
+// The records are read by chunks, so that a corrupt length does not
+// allocate more than the file holds
+#define RESULT_READ_CHUNK (1 << 20)
+
+
+// Helpers to serialize plain values into a byte vector and back
+template <typename T>
+static void put(vector<char> &v, T x)
+{
+    const char *p = (const char *) &x;
+    v.insert(v.end(), p, p + sizeof(T));
+}
+
+template <typename T>
+static bool get(const vector<char> &v, size_t &pos, T &x)
+{
+    if (pos + sizeof(T) > v.size())
+        return false;
+    memcpy(&x, &v[pos], sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+
+/**
+* Writer
+*/
+ResultWriter::ResultWriter() : m_file(0), m_buffer(0), m_L(0), m_histos(false)
+{
+}
+
+ResultWriter::~ResultWriter()
+{
+    close();
+}
+
+bool ResultWriter::open(const char *fname, int L, bool with_histos)
+{
+    close();
+    if (NULL == (m_file = fopen(fname, "wb")))
+        return false;
+
+    // All the records go through a single large buffer
+    m_buffer = new char[RESULT_BUFFER_SIZE];
+    setvbuf(m_file, m_buffer, _IOFBF, RESULT_BUFFER_SIZE);
+
+    m_L = L;
+    m_histos = with_histos;
+
+    uint32_t header[3] = {RESULT_IO_VERSION, with_histos ? (uint32_t) RESULT_HISTOS : 0, (uint32_t) L};
+    return fwrite(RESULT_MAGIC, 1, 8, m_file) == 8
+           && fwrite(header, sizeof(uint32_t), 3, m_file) == 3;
+}
+
+bool ResultWriter::write(const Keypoint &kp, const KeypointResult &res)
+{
+    if (!m_file)
+        return false;
+
+    m_record.clear();
+    put<uint32_t>(m_record, 0); // length, filled below
+    put<int32_t>(m_record, kp.x);
+    put<int32_t>(m_record, kp.y);
+    put<int32_t>(m_record, kp.r);
+    put<int32_t>(m_record, res.nb_pixels);
+
+    put<uint32_t>(m_record, res.modes.size());
+    for (size_t i(0); i < res.modes.size(); i++) {
+        put<int32_t>(m_record, res.modes[i].a);
+        put<int32_t>(m_record, res.modes[i].b);
+        put<float>(m_record, res.modes[i].orientation);
+        put<float>(m_record, res.modes[i].log_nfa);
+    }
+
+    put<uint32_t>(m_record, res.peaks.size());
+    for (size_t i(0); i < res.peaks.size(); i++) {
+        put<int32_t>(m_record, res.peaks[i].bin);
+        put<float>(m_record, res.peaks[i].orientation);
+        put<float>(m_record, res.peaks[i].ratio);
+    }
+
+    if (m_histos) {
+        if ((int) res.histo_ac.size() != m_L || (int) res.histo_lowe.size() != m_L)
+            return false;
+        for (int i(0); i < m_L; i++)
+            put<float>(m_record, res.histo_ac[i]);
+        for (int i(0); i < m_L; i++)
+            put<float>(m_record, res.histo_lowe[i]);
+    }
+
+    uint32_t length = m_record.size() - sizeof(uint32_t);
+    memcpy(&m_record[0], &length, sizeof(uint32_t));
+    return fwrite(&m_record[0], 1, m_record.size(), m_file) == m_record.size();
+}
+
+bool ResultWriter::close()
+{
+    bool ok = true;
+    if (m_file) {
+        ok = (fclose(m_file) == 0);
+        m_file = 0;
+    }
+    delete[] m_buffer;
+    m_buffer = 0;
+    return ok;
+}
+
+
+/**
+* Reader
+*/
+ResultReader::ResultReader() : m_file(0), m_L(0), m_histos(false), m_max_length(0),
+    m_failed(false)
+{
+}
+
+ResultReader::~ResultReader()
+{
+    close();
+}
+
+bool ResultReader::open(const char *fname)
+{
+    close();
+    m_failed = false;
+    if (NULL == (m_file = fopen(fname, "rb")))
+        return false;
+
+    char magic[8];
+    uint32_t header[3];
+    if (fread(magic, 1, 8, m_file) != 8 || memcmp(magic, RESULT_MAGIC, 8) != 0
+        || fread(header, sizeof(uint32_t), 3, m_file) != 3
+        || header[0] != RESULT_IO_VERSION || header[2] == 0 || header[2] > INT_MAX) {
+        close();
+        return false;
+    }
+
+    // A record has at most one mode per interval [a,b] (the L*L coefficients
+    // of the matrix of browse_intervals()) and one peak per bin
+    m_histos = header[1] & RESULT_HISTOS;
+    m_L = header[2];
+    uint64_t L = m_L;
+    m_max_length = 4 * sizeof(int32_t) + 2 * sizeof(uint32_t) + L * L * 16 + L * 12
+                   + (m_histos ? 2 * L * sizeof(float) : 0);
+    return true;
+}
+
+// The stream ends cleanly if it ends on a record boundary; anything else
+// (truncated or corrupt record) sets the error state
+bool ResultReader::read(Keypoint &kp, KeypointResult &res)
+{
+    if (!m_file || m_failed)
+        return false;
+    uint32_t length;
+    size_t n = fread(&length, 1, sizeof(uint32_t), m_file);
+    if (n == 0 && !ferror(m_file))
+        return false;
+    if (n != sizeof(uint32_t) || !read_record(length, kp, res)) {
+        m_failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool ResultReader::read_record(uint32_t length, Keypoint &kp, KeypointResult &res)
+{
+    if (length == 0 || length > m_max_length)
+        return false;
+    m_record.clear();
+    for (size_t done(0); done < length; ) {
+        size_t n = min((size_t) length - done, (size_t) RESULT_READ_CHUNK);
+        m_record.resize(done + n);
+        if (fread(&m_record[done], 1, n, m_file) != n)
+            return false;
+        done += n;
+    }
+
+    res.modes.clear();
+    res.peaks.clear();
+    res.histo_ac.clear();
+    res.histo_lowe.clear();
+
+    size_t pos(0);
+    int32_t x, y, r, nb_pixels;
+    uint32_t n_modes, n_peaks;
+    if (!get(m_record, pos, x) || !get(m_record, pos, y) || !get(m_record, pos, r)
+        || !get(m_record, pos, nb_pixels) || !get(m_record, pos, n_modes))
+        return false;
+    kp.x = x;
+    kp.y = y;
+    kp.r = r;
+    res.nb_pixels = nb_pixels;
+
+    for (uint32_t i(0); i < n_modes; i++) {
+        int32_t a, b;
+        Mode m;
+        if (!get(m_record, pos, a) || !get(m_record, pos, b)
+            || !get(m_record, pos, m.orientation) || !get(m_record, pos, m.log_nfa))
+            return false;
+        m.a = a;
+        m.b = b;
+        res.modes.push_back(m);
+    }
+
+    if (!get(m_record, pos, n_peaks))
+        return false;
+    for (uint32_t i(0); i < n_peaks; i++) {
+        int32_t bin;
+        Peak p;
+        if (!get(m_record, pos, bin) || !get(m_record, pos, p.orientation)
+            || !get(m_record, pos, p.ratio))
+            return false;
+        p.bin = bin;
+        res.peaks.push_back(p);
+    }
+
+    if (m_histos) {
+        if (m_record.size() - pos < 2 * (size_t) m_L * sizeof(float))
+            return false;
+        res.histo_ac.resize(m_L);
+        res.histo_lowe.resize(m_L);
+        for (int i(0); i < m_L; i++)
+            if (!get(m_record, pos, res.histo_ac[i]))
+                return false;
+        for (int i(0); i < m_L; i++)
+            if (!get(m_record, pos, res.histo_lowe[i]))
+                return false;
+    }
+    return pos == m_record.size();
+}
+
+void ResultReader::close()
+{
+    if (m_file)
+        fclose(m_file);
+    m_file = 0;
+}
+
+
+// Read a list of keypoints, given as one "x y r" triplet per line
+bool read_keypoints(const char *fname, vector<Keypoint> &kps)
+{
+    ifstream flux(fname);
+    if (!flux)
+        return false;
+
+    Keypoint kp;
+    while (flux >> kp.x >> kp.y >> kp.r)
+        kps.push_back(kp);
+    return flux.eof();
+}
+
+
+// Write the results of one keypoint in the text files histo_ac.txt,
+// histo_lowe.txt, modes_ac.txt, modes_lowe.txt and nb_pixels_ac.txt of
+// the current directory. The histogram files are only written if the
+// histograms are available.
+void write_text_results(const KeypointResult &res, int L)
+{
+    ofstream flux;
+
+    if ((int) res.histo_ac.size() == L) {
+        flux.open("histo_ac.txt");
+        for (int i(0); i<L; i++)
+            flux << res.histo_ac[i] << " ";
+        flux.close();
+    }
+
+    // Save the number of pixels used for the histogram construction
+    flux.open("nb_pixels_ac.txt");
+    flux << res.nb_pixels << endl;
+    flux.close();
+
+    // Save modes, orientations and NFA (approximated)
+    flux.open("modes_ac.txt");
+    for (size_t i(0); i<res.modes.size(); i++) {
+        flux << "[" << res.modes[i].a << "," << res.modes[i].b << "]" << " ; "
+             << res.modes[i].orientation << " ; "
+             << res.modes[i].log_nfa << endl;
+    }
+    flux.close();
+
+    if ((int) res.histo_lowe.size() == L) {
+        flux.open("histo_lowe.txt");
+        for (int i(0); i<L; i++)
+            flux << res.histo_lowe[i] << " ";
+        flux.close();
+    }
+
+    // Save orientations associated to local maxima
+    flux.open("modes_lowe.txt");
+    for (size_t i(0); i<res.peaks.size(); i++) {
+        flux <<  "[" << res.peaks[i].bin << "," << res.peaks[i].bin << "]" << " ; "
+             << res.peaks[i].orientation << " ; "
+             << res.peaks[i].ratio << endl;
+    }
+    flux.close();
+}
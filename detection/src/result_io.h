@@ -0,0 +1,88 @@
+#ifndef RESULT_IO_H_INCLUDED
+#define RESULT_IO_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "keypoint.h"
+
+/**
+* Binary result stream. The file starts with a header
+*     char[8] magic "MODESRES", uint32 version, uint32 flags, uint32 n_bins
+* followed by one record per keypoint, each one prefixed by its length in
+* bytes (uint32, not counting itself):
+*     int32 x, y, r, nb_pixels
+*     uint32 n_modes, then n_modes times {int32 a, b; float orientation, log_nfa}
+*     uint32 n_peaks, then n_peaks times {int32 bin; float orientation, ratio}
+*     if flags & RESULT_HISTOS: n_bins floats (histo_ac), n_bins floats (histo_lowe)
+* All the values are stored in the native byte order.
+*/
+#define RESULT_IO_VERSION 1
+#define RESULT_HISTOS 0x1
+
+/**
+* Destination of the results of a batch of keypoints
+*/
+class ResultSink
+{
+public :
+    virtual ~ResultSink() {}
+    virtual bool write(const Keypoint &kp, const KeypointResult &res) = 0;
+    virtual bool close() = 0;
+};
+
+class ResultWriter : public ResultSink
+{
+public :
+    ResultWriter();
+    ~ResultWriter();
+
+    bool open(const char *fname, int L, bool with_histos);
+    bool write(const Keypoint &kp, const KeypointResult &res);
+    bool close();
+
+private :
+    ResultWriter(const ResultWriter&);
+    ResultWriter& operator=(const ResultWriter&);
+
+    FILE *m_file;
+    char *m_buffer; // stdio buffer
+    int m_L;
+    bool m_histos;
+    std::vector<char> m_record; // the record being serialized
+};
+
+class ResultReader
+{
+public :
+    ResultReader();
+    ~ResultReader();
+
+    bool open(const char *fname);
+    bool read(Keypoint &kp, KeypointResult &res); // false at the end of the stream
+    void close();
+
+    int get_L() const { return m_L; }
+    bool has_histos() const { return m_histos; }
+    // The last read() found a truncated or corrupt record
+    bool failed() const { return m_failed; }
+
+private :
+    ResultReader(const ResultReader&);
+    ResultReader& operator=(const ResultReader&);
+
+    bool read_record(uint32_t length, Keypoint &kp, KeypointResult &res);
+
+    FILE *m_file;
+    int m_L;
+    bool m_histos;
+    uint64_t m_max_length; // length of the largest record of L bins
+    bool m_failed;
+    std::vector<char> m_record;
+};
+
+bool read_keypoints(const char *fname, std::vector<Keypoint> &kps);
+void write_text_results(const KeypointResult &res, int L);
+
+#endif // RESULT_IO_H_INCLUDED
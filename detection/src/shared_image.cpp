@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+
+#include "io_png.h"
+#include "instrument.h"
+#include "modes_detection.h"
+#include "shared_image.h"
+
+using namespace std;
+
+#define SHARED_MAGIC "MODESSHM"
+#define SHARED_HEADER_SIZE 4096
+// Attempts to open a segment that is being removed by its last user
+#define SHARED_OPEN_TRIES 8
+
+struct SharedHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t nx;
+    uint64_t ny;
+    uint32_t ready; // set once the image is completely written
+};
+
+/**
+* Constructor and destructor
+*/
+SharedImage::SharedImage() : m_fd(-1), m_map(0), m_size(0), m_nx(0), m_ny(0),
+    m_data(0), m_norm(0), m_theta(0), m_decoded(false)
+{
+}
+
+SharedImage::~SharedImage()
+{
+    close();
+}
+
+
+// Check if the segment fd is still named, and if its image is complete
+static bool segment_state(int fd, bool &named, bool &ready)
+{
+    struct stat ss;
+    if (fstat(fd, &ss) != 0)
+        return false;
+    named = ss.st_nlink > 0;
+    ready = false;
+    if ((size_t) ss.st_size < SHARED_HEADER_SIZE)
+        return true;
+
+    void *p = mmap(NULL, SHARED_HEADER_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+        return false;
+    const SharedHeader *h = (const SharedHeader *) p;
+    ready = memcmp(h->magic, SHARED_MAGIC, 8) == 0 && h->version == SHARED_IMAGE_VERSION
+            && h->ready;
+    munmap(p, SHARED_HEADER_SIZE);
+    return true;
+}
+
+
+// Take (or release) the creation lock of the segment : a write lock on its
+// first byte, independent of the flock() reference count. It only excludes
+// the other writers, never the processes that use the complete image.
+static bool creation_lock(int fd, bool lock)
+{
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = lock ? F_WRLCK : F_UNLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = 0;
+    fl.l_len = 1;
+#ifdef F_OFD_SETLKW
+    // Owned by the open file, so that two threads of a process exclude each other
+    int cmd = F_OFD_SETLKW;
+#else
+    int cmd = F_SETLKW;
+#endif
+    while (fcntl(fd, cmd, &fl) != 0)
+        if (errno != EINTR)
+            return false;
+    return true;
+}
+
+
+// Attach to the segment of the image fname, or create it. The segment is
+// used with a shared lock, held until close(). If it is new, or if its
+// writer did not complete it, it is written under the creation lock, and
+// the processes waiting for the image block on that lock only.
+bool SharedImage::open(const char *fname, bool with_field)
+{
+    close();
+
+    struct stat st;
+    if (stat(fname, &st) != 0)
+        return false;
+    char name[256];
+    snprintf(name, sizeof(name), "/modes_%lx_%lx_%lx_%lx.%09ld%s",
+             (unsigned long) st.st_dev, (unsigned long) st.st_ino, (unsigned long) st.st_size,
+             (unsigned long) st.st_mtim.tv_sec, (long) st.st_mtim.tv_nsec, with_field ? "_g" : "");
+    m_name = name;
+
+    for (int k(0); k < SHARED_OPEN_TRIES; k++) {
+        bool named, ready;
+        m_fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+        if (m_fd < 0)
+            return false;
+        if (flock(m_fd, LOCK_SH) != 0 || !segment_state(m_fd, named, ready)) {
+            close();
+            return false;
+        }
+
+        // Not complete : wait for the process writing it, and check again
+        // since it has completed it in the meantime, or died
+        if (named && !ready) {
+            if (!creation_lock(m_fd, true) || !segment_state(m_fd, named, ready)) {
+                close();
+                return false;
+            }
+            bool ok = !named || ready || publish(fname, with_field);
+            creation_lock(m_fd, false);
+            if (!ok) {
+                close();
+                return false;
+            }
+        }
+
+        // The segment has been removed by its last user after we opened it
+        if (!named) {
+            ::close(m_fd);
+            m_fd = -1;
+            continue;
+        }
+
+        if (!attach()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+    close();
+    return false;
+}
+
+
+// Decode the image fname directly into the segment, under the creation lock
+bool SharedImage::publish(const char *fname, bool with_field)
+{
+    size_t nx, ny;
+    if (read_png_size(fname, &nx, &ny) != 0)
+        return false;
+
+    size_t planes = with_field ? 3 : 1;
+    size_t size = SHARED_HEADER_SIZE + planes * nx * ny * sizeof(float);
+    void *p = MAP_FAILED;
+    if (ftruncate(m_fd, 0) == 0 && ftruncate(m_fd, size) == 0)
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (p == MAP_FAILED)
+        return false;
+
+    float *data = (float *) ((char *) p + SHARED_HEADER_SIZE);
+    int rc;
+    {
+        MODES_STAGE(STAGE_DECODE);
+        PngReader reader;
+        size_t nx_read, ny_read;
+        rc = reader.read_f32_gray(fname, &nx_read, &ny_read, 0, ny, data, nx, nx * ny);
+        if (rc == 0 && (nx_read != nx || ny_read != ny))
+            rc = -1;
+    }
+    if (rc != 0) {
+        munmap(p, size);
+        return false;
+    }
+    if (with_field)
+        orientation_field(data, nx, ny, nx, data + nx * ny, data + 2 * nx * ny);
+
+    SharedHeader *h = (SharedHeader *) p;
+    memcpy(h->magic, SHARED_MAGIC, 8);
+    h->version = SHARED_IMAGE_VERSION;
+    h->flags = with_field ? SHARED_FIELD : 0;
+    h->nx = nx;
+    h->ny = ny;
+    __atomic_store_n(&h->ready, 1, __ATOMIC_RELEASE);
+    munmap(p, size);
+    m_decoded = true;
+    return true;
+}
+
+
+// Map the complete segment read-only
+bool SharedImage::attach()
+{
+    struct stat ss;
+    if (fstat(m_fd, &ss) != 0 || (size_t) ss.st_size < SHARED_HEADER_SIZE)
+        return false;
+    m_size = ss.st_size;
+    m_map = mmap(NULL, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (m_map == MAP_FAILED) {
+        m_map = 0;
+        return false;
+    }
+
+    const SharedHeader *h = (const SharedHeader *) m_map;
+    size_t planes = (h->flags & SHARED_FIELD) ? 3 : 1;
+    if (m_size < SHARED_HEADER_SIZE + planes * h->nx * h->ny * sizeof(float))
+        return false;
+    m_nx = h->nx;
+    m_ny = h->ny;
+    m_data = (const float *) ((const char *) m_map + SHARED_HEADER_SIZE);
+    if (h->flags & SHARED_FIELD) {
+        m_norm = m_data + m_nx * m_ny;
+        m_theta = m_data + 2 * m_nx * m_ny;
+    }
+    return true;
+}
+
+
+// Release the image. The process that gets the exclusive lock is the last
+// user of the segment, and removes it.
+void SharedImage::close()
+{
+    if (m_map)
+        munmap(m_map, m_size);
+    if (m_fd >= 0) {
+        struct stat ss;
+        if (flock(m_fd, LOCK_EX | LOCK_NB) == 0 && fstat(m_fd, &ss) == 0 && ss.st_nlink > 0)
+            shm_unlink(m_name.c_str());
+        ::close(m_fd);
+    }
+    m_fd = -1;
+    m_map = 0;
+    m_size = m_nx = m_ny = 0;
+    m_data = m_norm = m_theta = 0;
+    m_decoded = false;
+}
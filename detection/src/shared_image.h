@@ -0,0 +1,64 @@
+#ifndef SHARED_IMAGE_H_INCLUDED
+#define SHARED_IMAGE_H_INCLUDED
+
+#include <stddef.h>
+#include <string>
+
+/**
+* Gray float image decoded from a PNG file, shared between the processes of
+* the host through a POSIX shared memory segment. The segment is named after
+* the identity of the file (device, inode, size and modification time), so
+* that a modified file gets a new segment. The first process decodes the
+* image into the segment, the next ones map it read-only.
+*
+* Every process holds a shared flock() on the segment while it uses it : the
+* kernel keeps this reference count, even if a process dies. The last one to
+* close the image removes the segment. The image is written under a separate
+* fcntl() lock on the first byte of the segment, so that the processes
+* waiting for it never wait for the ones using it.
+*
+* The segment starts with a page holding the header
+*     char[8] magic "MODESSHM", uint32 version, uint32 flags, uint64 nx, ny,
+*     uint32 ready
+* followed by the nx*ny floats of the image, then, if flags & SHARED_FIELD,
+* the norm and angle planes of its gradient (see orientation_field()).
+*/
+#define SHARED_IMAGE_VERSION 1
+#define SHARED_FIELD 0x1
+
+class SharedImage
+{
+public :
+    SharedImage();
+    ~SharedImage();
+
+    bool open(const char *fname, bool with_field);
+    void close();
+
+    size_t get_nx() const { return m_nx; }
+    size_t get_ny() const { return m_ny; }
+    const float *get_data() const { return m_data; }
+    const float *get_norm() const { return m_norm; } // NULL without the field
+    const float *get_theta() const { return m_theta; }
+    bool get_decoded() const { return m_decoded; } // decoded by this process
+
+private :
+    SharedImage(const SharedImage&);
+    SharedImage& operator=(const SharedImage&);
+
+    bool publish(const char *fname, bool with_field);
+    bool attach();
+
+    std::string m_name;
+    int m_fd;
+    void *m_map;
+    size_t m_size;
+    size_t m_nx;
+    size_t m_ny;
+    const float *m_data;
+    const float *m_norm;
+    const float *m_theta;
+    bool m_decoded;
+};
+
+#endif // SHARED_IMAGE_H_INCLUDED
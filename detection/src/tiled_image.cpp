@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "image_mmap.h"
+#include "tiled_image.h"
+
+using namespace std;
+
+// Bytes read to parse the header, enough for any PGM header without huge comments
+#define HEADER_READ_SIZE 4096
+
+/**
+* Constructor and destructor
+*/
+TiledImage::TiledImage() : m_fd(-1), m_tile_size(0), m_budget(0), m_used(0), m_loads(0)
+{
+    m_header.type = PIXEL_U8;
+    m_header.nx = m_header.ny = m_header.stride = m_header.offset = 0;
+}
+
+TiledImage::~TiledImage()
+{
+    close();
+}
+
+bool TiledImage::open(const char *fname, size_t tile_size, size_t budget)
+{
+    close();
+    if (tile_size == 0)
+        return false;
+
+    m_fd = ::open(fname, O_RDONLY);
+    if (m_fd < 0)
+        return false;
+
+    struct stat st;
+    char head[HEADER_READ_SIZE];
+    ssize_t len;
+    if (fstat(m_fd, &st) != 0 || (len = pread(m_fd, head, sizeof(head), 0)) < 0
+        || !parse_image_header(head, len, st.st_size, m_header)) {
+        close();
+        return false;
+    }
+
+    m_tile_size = tile_size;
+    m_budget = budget;
+    return true;
+}
+
+void TiledImage::close()
+{
+    if (m_fd >= 0)
+        ::close(m_fd);
+    m_fd = -1;
+    m_lru.clear();
+    m_tiles.clear();
+    m_used = m_loads = 0;
+    m_header.nx = m_header.ny = m_header.stride = m_header.offset = 0;
+}
+
+
+// Tile (tx,ty), read from the file if it is not in the cache
+const TiledImage::Tile *TiledImage::get_tile(size_t tx, size_t ty)
+{
+    size_t ntx = (m_header.nx + m_tile_size - 1) / m_tile_size;
+    size_t index = ty * ntx + tx;
+
+    map<size_t, list<Tile>::iterator>::iterator it = m_tiles.find(index);
+    if (it != m_tiles.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return &m_lru.front();
+    }
+
+    size_t ps = pixel_size(m_header.type);
+    size_t x0 = tx * m_tile_size, y0 = ty * m_tile_size;
+    size_t w = min(m_tile_size, m_header.nx - x0), h = min(m_tile_size, m_header.ny - y0);
+    size_t bytes = w * h * ps;
+
+    // Evict the least recently used tiles to stay within the budget
+    while (!m_lru.empty() && m_used + bytes > m_budget) {
+        m_used -= m_lru.back().data.size();
+        m_tiles.erase(m_lru.back().index);
+        m_lru.pop_back();
+    }
+
+    m_lru.push_front(Tile());
+    Tile &t = m_lru.front();
+    t.index = index;
+    t.data.resize(bytes);
+    for (size_t j(0); j < h; j++) {
+        off_t offset = m_header.offset + ((off_t) (y0 + j) * m_header.stride + x0) * ps;
+        if (pread(m_fd, &t.data[j * w * ps], w * ps, offset) != (ssize_t) (w * ps)) {
+            m_lru.pop_front();
+            return 0;
+        }
+    }
+
+    m_tiles[index] = m_lru.begin();
+    m_used += bytes;
+    m_loads++;
+    return &t;
+}
+
+bool TiledImage::read_window(size_t x0, size_t y0, size_t x1, size_t y1, void *out, size_t stride)
+{
+    if (m_fd < 0 || x1 > m_header.nx || y1 > m_header.ny || x0 > x1 || y0 > y1)
+        return false;
+    if (x0 == x1 || y0 == y1)
+        return true;
+    if (stride == 0)
+        stride = x1 - x0;
+    if (stride < x1 - x0)
+        return false;
+
+    size_t ps = pixel_size(m_header.type);
+    size_t wx = stride * ps;
+    unsigned char *dst = (unsigned char *) out;
+
+    // Copy the intersection of the window with each of the tiles it covers
+    for (size_t ty = y0 / m_tile_size; ty * m_tile_size < y1; ty++) {
+        for (size_t tx = x0 / m_tile_size; tx * m_tile_size < x1; tx++) {
+            const Tile *t = get_tile(tx, ty);
+            if (!t)
+                return false;
+
+            size_t tx0 = tx * m_tile_size, ty0 = ty * m_tile_size;
+            size_t tw = min(m_tile_size, m_header.nx - tx0);
+            size_t i0 = max(x0, tx0), i1 = min(x1, tx0 + tw);
+            size_t j0 = max(y0, ty0), j1 = min(y1, ty0 + m_tile_size);
+            for (size_t j(j0); j < j1; j++)
+                memcpy(dst + (j - y0) * wx + (i0 - x0) * ps,
+                       &t->data[((j - ty0) * tw + i0 - tx0) * ps], (i1 - i0) * ps);
+        }
+    }
+    return true;
+}
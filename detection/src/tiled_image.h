@@ -0,0 +1,60 @@
+#ifndef TILED_IMAGE_H_INCLUDED
+#define TILED_IMAGE_H_INCLUDED
+
+#include <stddef.h>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "image_mmap.h"
+
+/**
+* PGM or raw float32 image (see image_mmap.h) read by square tiles of
+* tile_size pixels, loaded lazily from the file with pread(). The loaded
+* tiles are kept in a cache, and the least recently used ones are evicted
+* when the cache would exceed budget bytes (at least one tile is kept).
+* All the offsets are 64bit, the size of the image is only bounded by the
+* file system.
+*/
+class TiledImage
+{
+public :
+    TiledImage();
+    ~TiledImage();
+
+    bool open(const char *fname, size_t tile_size, size_t budget);
+    void close();
+
+    PixelType get_type() const { return m_header.type; }
+    size_t get_nx() const { return m_header.nx; }
+    size_t get_ny() const { return m_header.ny; }
+    size_t get_tile_size() const { return m_tile_size; }
+    size_t get_loads() const { return m_loads; } // number of tiles read from the file
+
+    // Copy the pixels of the window [x0,x1)x[y0,y1) to out, with lines of
+    // stride pixels (x1-x0 if 0)
+    bool read_window(size_t x0, size_t y0, size_t x1, size_t y1, void *out, size_t stride = 0);
+
+private :
+    TiledImage(const TiledImage&);
+    TiledImage& operator=(const TiledImage&);
+
+    struct Tile
+    {
+        size_t index; // ty*ntx+tx
+        std::vector<unsigned char> data; // lines of min(tile_size, nx-tx*tile_size) pixels
+    };
+
+    const Tile *get_tile(size_t tx, size_t ty);
+
+    int m_fd;
+    ImageHeader m_header;
+    size_t m_tile_size;
+    size_t m_budget;
+    size_t m_used; // bytes of the cached tiles
+    size_t m_loads;
+    std::list<Tile> m_lru; // most recently used first
+    std::map<size_t, std::list<Tile>::iterator> m_tiles;
+};
+
+#endif // TILED_IMAGE_H_INCLUDED
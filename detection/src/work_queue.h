@@ -0,0 +1,89 @@
+#ifndef WORK_QUEUE_H_INCLUDED
+#define WORK_QUEUE_H_INCLUDED
+
+#include <stddef.h>
+#include <pthread.h>
+#include <deque>
+
+/**
+* Bounded queue between the threads of two stages of a pipeline. push()
+* waits while the queue holds capacity items, pop() waits while it is empty.
+* Once all the producers have called producer_done(), pop() returns false
+* as soon as the queue is empty. close() drops the items left and ends the
+* queue at once.
+*/
+template <typename T>
+class WorkQueue
+{
+public :
+    WorkQueue(size_t capacity, int producers) : m_capacity(capacity ? capacity : 1),
+        m_producers(producers)
+    {
+        pthread_mutex_init(&m_mutex, NULL);
+        pthread_cond_init(&m_not_empty, NULL);
+        pthread_cond_init(&m_not_full, NULL);
+    }
+
+    ~WorkQueue()
+    {
+        pthread_cond_destroy(&m_not_full);
+        pthread_cond_destroy(&m_not_empty);
+        pthread_mutex_destroy(&m_mutex);
+    }
+
+    void push(const T &item)
+    {
+        pthread_mutex_lock(&m_mutex);
+        while (m_items.size() >= m_capacity)
+            pthread_cond_wait(&m_not_full, &m_mutex);
+        m_items.push_back(item);
+        pthread_cond_signal(&m_not_empty);
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+    bool pop(T &item)
+    {
+        pthread_mutex_lock(&m_mutex);
+        while (m_items.empty() && m_producers > 0)
+            pthread_cond_wait(&m_not_empty, &m_mutex);
+        bool ok = !m_items.empty();
+        if (ok) {
+            item = m_items.front();
+            m_items.pop_front();
+            pthread_cond_signal(&m_not_full);
+        }
+        pthread_mutex_unlock(&m_mutex);
+        return ok;
+    }
+
+    void producer_done()
+    {
+        pthread_mutex_lock(&m_mutex);
+        if (--m_producers == 0)
+            pthread_cond_broadcast(&m_not_empty);
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+    void close()
+    {
+        pthread_mutex_lock(&m_mutex);
+        m_items.clear();
+        m_producers = 0;
+        pthread_cond_broadcast(&m_not_empty);
+        pthread_cond_broadcast(&m_not_full);
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+private :
+    WorkQueue(const WorkQueue&);
+    WorkQueue& operator=(const WorkQueue&);
+
+    std::deque<T> m_items;
+    size_t m_capacity;
+    int m_producers;
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_not_empty;
+    pthread_cond_t m_not_full;
+};
+
+#endif // WORK_QUEUE_H_INCLUDED
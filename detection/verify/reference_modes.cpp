@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+#include <math.h>
+#include <vector>
+
+#include "reference_modes.h"
+
+using namespace std;
+
+namespace reference {
+
+// The parts of the class Histo used by the detection of modes
+class Histo
+{
+public :
+    Histo(int L, const float *data) : m_L(L), m_N(L*(L-1)+1), m_M(0), m_data(data)
+    {
+        for (int i=0; i<L; i++)
+            m_M += data[i];
+    }
+
+    int get_L() const { return m_L; }
+    int get_N() const { return m_N; }
+    float get_M() const { return m_M; }
+    float operator[](int i) const { return m_data[good_modulus(i,m_L)]; }
+
+    int sum(int a, int b) const
+    {
+        float s(0);
+        if (a <= b) {
+            for (int i=a; i<=b; i++)
+                s += m_data[i];
+        } else {
+            for (int i=a; i<m_L; i++)
+                s += m_data[i];
+            for (int i=0; i<=b; i++)
+                s += m_data[i];
+        }
+        return s;
+    }
+
+    float angle(int bin) const
+    {
+        float x = bin;
+        return -M_PI + x*(2*M_PI/m_L);
+    }
+
+    static int good_modulus(int n, int p)
+    {
+        if (p < 0) return good_modulus(n, -p);
+
+        int r;
+        if (n >= 0)
+            r = n % p;
+        else {
+            r = p - (-n) % p;
+            if (r == p)
+                r = 0;
+        }
+        return r;
+    }
+
+private :
+    int const m_L;
+    int const m_N;
+    float m_M;
+    const float *m_data;
+};
+
+
+static float compute_entropy(float r, float p)
+{
+    if (r==1)
+        return -log(p);
+
+    float h = r*log(r/p)+(1-r)*log((1-r)/(1-p));
+    return h;
+}
+
+
+// Meaningful intervals : 2, meaningful gaps : -1, others : 0
+static void browse_intervals(Histo &histo, float epsilon, int **intervals, float **entropy)
+{
+    int L = histo.get_L();
+    int M = histo.get_M();
+    int N = histo.get_N();
+    float thresh = log(N/epsilon)/M;
+
+    for (int a=0; a<L; a++) {
+        for (int b=0; b<L; b++) {
+            int k = histo.sum(a,b);
+            float r = (float) k/M;
+            float p = (1+b-a)/((float) L) + (b<a);
+            float e = compute_entropy(r,p);
+
+            entropy[a][b] = e;
+
+            if (e>thresh) {
+                if (r>p)
+                    intervals[a][b] = 2;
+                else
+                    intervals[a][b] = -1;
+            } else
+                intervals[a][b] = 0;
+        }
+    }
+}
+
+
+static void spread_gaps(int L, int **intervals)
+{
+    for (int a(0); a<L; a++) {
+        for (int b(0); b<a; b++) {
+            if (intervals[a][b] < 0)
+                for (int i(a); i>b; i--)
+                    for (int j(b); j<i; j++)
+                        intervals[i][j] = 0;
+        }
+
+        for (int b(a); b<L; b++) {
+            if (intervals[a][b] < 0)
+                for (int i(a); i>(b-L); i--)
+                    for (int j(b); j<(i+L); j++)
+                        intervals[(i+L) % L][j % L] = 0;
+        }
+    }
+}
+
+
+static void discard_modes(int L, int **intervals, float **entropy)
+{
+    for (int a(0); a<L; a++) {
+        for (int b(a); b<L; b++) {
+            if (intervals[a][b] > 1) {
+                float e(entropy[a][b]);
+                int i(a);
+
+                while (i<=b) {
+                    int j(b);
+                    while (j>=i) {
+                        if ((j-i < b-a) && (intervals[i][j] > 0)) {
+                            if (entropy[i][j] < e)
+                                intervals[i][j] = 1;
+                            else
+                                intervals[a][b] = 1;
+                        }
+                        j--;
+                    }
+                    i++;
+                }
+            }
+        }
+
+        for (int b(0); b<a; b++) {
+            if (intervals[a][b] > 1) {
+                float e(entropy[a][b]);
+                int i(a);
+
+                while (i<=(b+L)) {
+                    int j(b);
+                    while (j>=(i-L)) {
+                        if (((j-i+L)%L < (b-a+L)%L) && (intervals[i % L][(j+L) % L] > 0)) {
+                            if (entropy[i % L][(j+L) % L] < e)
+                                intervals[i % L][(j+L) % L] = 1;
+                            else
+                                intervals[a][b] = 1;
+                        }
+                        j--;
+                    }
+                    i++;
+                }
+            }
+        }
+    }
+}
+
+
+vector<float> max_modes_detection(const float *data, int L, float epsilon)
+{
+    Histo histo(L, data);
+    vector<float> list;
+
+    if (histo.get_M() > 0) {
+        int **intervals = new int*[L];
+        float **entropy = new float*[L];
+        for (int i=0; i<L; i++) {
+            intervals[i] = new int[L];
+            entropy[i] = new float[L];
+        }
+
+        browse_intervals(histo,epsilon,intervals,entropy);
+        spread_gaps(L, intervals);
+        discard_modes(L,intervals,entropy);
+
+        for (int a=0; a<L; a++) {
+            for (int b=0; b<L; b++) {
+                if (intervals[a][b] > 1) {
+                    list.push_back(a);
+                    list.push_back(b);
+
+                    float M = histo.get_M();
+                    float log_nfa = -log10(histo.get_N())+M*entropy[a][b]/log(10);
+                    list.push_back(log_nfa);
+                }
+            }
+        }
+
+        for (int i=0; i<L; i++) {
+            delete[] intervals[i];
+            delete[] entropy[i];
+        }
+        delete[] intervals;
+        delete[] entropy;
+    }
+    return list;
+}
+
+
+float compute_orientation(const float *data, int L, int a, int b)
+{
+    Histo h(L, data);
+    double theta = 0.0;
+    if (a <= b)
+        for (int i(a); i<=b; i++)
+            theta += h.angle(i)*h[i];
+    else {
+        for (int i(a); i<h.get_L(); i++)
+            theta += h.angle(i)*h[i];
+        for (int i=0; i<=b; i++)
+            theta += (h.angle(i)+2*M_PI)*h[i];
+    }
+
+    theta /= h.sum(a,b);
+    return fmod(theta, 2*M_PI);
+}
+
+}
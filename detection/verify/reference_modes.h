@@ -0,0 +1,21 @@
+#ifndef REFERENCE_MODES_H_INCLUDED
+#define REFERENCE_MODES_H_INCLUDED
+
+#include <vector>
+
+// Frozen copy of the a contrario detection of modes of version 1.0
+// (src/modes_detection.cpp and src/Histo.cpp), the oracle of verify_modes.
+// It works on a plain array of L bins and must not be optimized : the
+// optimized versions of src/ are checked against it.
+namespace reference {
+
+// Same list [a1,b1,log_nfa1,a2,b2,log_nfa2...] as max_modes_detection()
+// for the histogram made of the L values of data
+std::vector<float> max_modes_detection(const float *data, int L, float epsilon);
+
+// Same as compute_orientation() for the mode [a,b] of this histogram
+float compute_orientation(const float *data, int L, int a, int b);
+
+}
+
+#endif // REFERENCE_MODES_H_INCLUDED
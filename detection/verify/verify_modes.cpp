@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2012, Carlo De Franchis <carlo.de-franchis@polytechnique.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+// Differential verification of the a contrario detection of modes : the
+// modes found by max_modes_detection() and compute_orientation() of src/
+// are compared with those of the frozen reference (reference_modes.cpp) on
+// random and adversarial histograms, for all the numbers of bins L up to
+// 360 and numbers of samples M from 0 to 10^7. The histograms of integer
+// values are also checked as counts of 16 bits (if they fit) and 32 bits
+// (CountHisto). The call syntax is
+//     verify_modes [-s seconds] [-r seed] [-t tolerance] [-v]
+// Without -s, a fixed set of cases is checked in a few seconds (make
+// verify). With -s, random cases are checked for the given time (soak).
+// The bounds of the modes must be the same, and their log-NFA and
+// orientation the same up to the relative tolerance (-t, 1e-4 by default).
+// Each mismatch is written on stderr with the histogram that produced it,
+// and the exit status is 1 if there is any.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits>
+#include <vector>
+
+#include "CountHisto.h"
+#include "Histo.h"
+#include "modes_detection.h"
+#include "reference_modes.h"
+#include "../bench/bench_common.h"
+
+using namespace std;
+
+#define MAX_L 360
+// Mismatches written before giving up
+#define MAX_REPORTS 10
+
+static const char *const kinds[] = {
+    "uniform", "single-peak", "multi-modal", "gap-heavy", "constant", "single-bin",
+    "twin-peaks", "alternating", "wrapping", "fractional", "sparse", "heavy-tailed"
+};
+#define N_KINDS ((int) (sizeof(kinds) / sizeof(kinds[0])))
+
+static const double sizes[] = {0, 1, 2, 3, 7, -1, 100, 1000, 1e4, 1e5, 1e6, 1e7}; // -1 : M = L
+#define N_SIZES ((int) (sizeof(sizes) / sizeof(sizes[0])))
+
+static const float epsilons[] = {1, 0.01, 100};
+
+
+// 64bit linear congruential generator, reproducible on every platform
+struct Random
+{
+    unsigned long long state;
+
+    unsigned int next()
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (unsigned int) (state >> 33);
+    }
+    // In [0,1)
+    double uniform() { return next() / 2147483648.; }
+    // In [0,n)
+    int integer(int n) { return (int) (uniform() * n); }
+};
+
+
+// Distance between the bins i and c on the circle of L bins
+static double circular(int i, double c, int L)
+{
+    double d = fabs(i - c);
+    return min(d, L - d);
+}
+
+
+// Histogram h of L bins and about M samples of the given kind. The counts
+// are integers, except for the kinds fractional and heavy-tailed, which are
+// weighted like the histograms of flag_norm=1.
+static void make_histo(Random &rnd, int L, double M, int kind, vector<float> &h)
+{
+    vector<double> w(L, 0);
+    switch (kind) {
+    case 0: // uniform : random samples
+        for (int i(0); i < L; i++)
+            w[i] = 1;
+        break;
+    case 1: { // single-peak over a background
+        double c = rnd.uniform() * L, s = 0.5 + rnd.uniform() * L / 8;
+        for (int i(0); i < L; i++)
+            w[i] = 0.02 + exp(-circular(i, c, L) * circular(i, c, L) / (2 * s * s));
+        break;
+    }
+    case 2: { // multi-modal : 2 to 5 peaks of random heights and widths
+        int n = 2 + rnd.integer(4);
+        for (int p(0); p < n; p++) {
+            double c = rnd.uniform() * L, s = 0.5 + rnd.uniform() * L / 16, a = 0.2 + rnd.uniform();
+            for (int i(0); i < L; i++)
+                w[i] += a * exp(-circular(i, c, L) * circular(i, c, L) / (2 * s * s));
+        }
+        for (int i(0); i < L; i++)
+            w[i] += 0.01;
+        break;
+    }
+    case 3: // gap-heavy : empty arcs and spikes
+        for (int i(0); i < L; i++)
+            w[i] = rnd.uniform() < 0.5 ? 0 : (rnd.uniform() < 0.2 ? 4 : 0.2);
+        for (int i = rnd.integer(L), n = rnd.integer(L / 2 + 1); n > 0; n--, i = (i + 1) % L)
+            w[i] = 0;
+        break;
+    case 4: // constant
+        for (int i(0); i < L; i++)
+            w[i] = 1;
+        break;
+    case 5: // single-bin
+        w[rnd.integer(L)] = 1;
+        break;
+    case 6: { // twin-peaks : two identical peaks, whose modes have the same entropy
+        int c = rnd.integer(L), s = 1 + rnd.integer(L / 12 + 1);
+        for (int i(0); i < L; i++) {
+            double d1 = circular(i, c, L), d2 = circular(i, c + L / 2, L);
+            w[i] = (d1 <= s) + (d2 <= s) + 0.05;
+        }
+        break;
+    }
+    case 7: // alternating : full and empty bins
+        for (int i(0); i < L; i++)
+            w[i] = i % 2 ? 0 : 1;
+        break;
+    case 8: // wrapping : a peak across the bins L-1 and 0
+        for (int i(0); i < L; i++)
+            w[i] = 0.02 + exp(-circular(i, 0, L) * circular(i, 0, L) / (2. + L / 10.));
+        break;
+    case 9: // fractional : random weights
+        for (int i(0); i < L; i++)
+            w[i] = rnd.uniform();
+        break;
+    case 10: // sparse : a few samples in random bins
+        for (int n = 1 + rnd.integer(L); n > 0; n--)
+            w[rnd.integer(L)] += 1;
+        break;
+    default: // heavy-tailed : weights over several orders of magnitude
+        for (int i(0); i < L; i++)
+            w[i] = exp(12 * rnd.uniform() - 6);
+    }
+
+    double sum(0);
+    for (int i(0); i < L; i++)
+        sum += w[i];
+    h.assign(L, 0);
+    if (sum <= 0 || M <= 0)
+        return;
+    bool integer = kind != 9 && kind != 11;
+    if (kind == 0 && M <= 1e5) {
+        // Multinomial draw
+        for (long n(0); n < (long) M; n++)
+            h[rnd.integer(L)] += 1;
+        return;
+    }
+    for (int i(0); i < L; i++) {
+        double v = w[i] * M / sum;
+        h[i] = integer ? floor(v + rnd.uniform()) : v;
+    }
+}
+
+
+// Relative comparison, with the infinities and NaNs compared as values
+static bool close(double x, double y, double tolerance)
+{
+    if (isnan(x) || isnan(y))
+        return isnan(x) && isnan(y);
+    if (isinf(x) || isinf(y))
+        return x == y;
+    return fabs(x - y) <= tolerance * max(1., fabs(y));
+}
+
+
+static void print_modes(const char *name, const vector<float> &modes, const vector<float> &orientations)
+{
+    fprintf(stderr, "  %s :", name);
+    for (size_t i(0); 3*i+2 < modes.size(); i++)
+        fprintf(stderr, " [%g,%g] %.9g %.9g;", modes[3*i], modes[3*i+1], modes[3*i+2], orientations[i]);
+    fprintf(stderr, "\n");
+}
+
+
+// Modes of the histogram histo (a Histo or a CountHisto) found by src/, and
+// their orientations
+template <typename H>
+static void detect(H &histo, float epsilon, vector<float> &modes, vector<float> &orientations)
+{
+    modes = max_modes_detection(histo, epsilon);
+    orientations.clear();
+    for (size_t i(0); 3*i+2 < modes.size(); i++)
+        orientations.push_back(compute_orientation(histo, (int) modes[3*i], (int) modes[3*i+1]));
+}
+
+
+// Counts of the histogram h of integer values, or false if some value is
+// not a count of C bits
+template <typename C>
+static bool make_counts(const vector<float> &h, vector<C> &counts)
+{
+    counts.resize(h.size());
+    for (size_t i(0); i < h.size(); i++) {
+        if (h[i] < 0 || h[i] != floor(h[i]) || h[i] > numeric_limits<C>::max())
+            return false;
+        counts[i] = (C) h[i];
+    }
+    return true;
+}
+
+
+// Checks one histogram. Returns false, and writes the case on stderr, if
+// the modes differ.
+static bool check(const vector<float> &h, float epsilon, const char *kind, double tolerance)
+{
+    int L = h.size();
+    vector<float> expected = reference::max_modes_detection(&h[0], L, epsilon);
+    vector<float> expected_orientations;
+    for (size_t i(0); 3*i+2 < expected.size(); i++)
+        expected_orientations.push_back(reference::compute_orientation(&h[0], L, (int) expected[3*i],
+                                                                       (int) expected[3*i+1]));
+
+    // The float histogram, then the counts
+    const char *name = "optimized";
+    vector<float> modes, orientations;
+    vector<uint16_t> counts16;
+    vector<uint32_t> counts32;
+    bool ok(true);
+    for (int pass(0); ok && pass < 3; pass++) {
+        if (pass == 0) {
+            Histo histo(L, &h[0]);
+            detect(histo, epsilon, modes, orientations);
+        } else if (pass == 1) {
+            if (!make_counts(h, counts16))
+                continue;
+            CountHisto16 histo(L, &counts16[0]);
+            detect(histo, epsilon, modes, orientations);
+            name = "counts16";
+        } else {
+            if (!make_counts(h, counts32))
+                continue;
+            CountHisto32 histo(L, &counts32[0]);
+            detect(histo, epsilon, modes, orientations);
+            name = "counts32";
+        }
+
+        ok = modes.size() == expected.size();
+        for (size_t i(0); ok && 3*i+2 < modes.size(); i++)
+            ok = modes[3*i] == expected[3*i] && modes[3*i+1] == expected[3*i+1]
+                 && close(modes[3*i+2], expected[3*i+2], tolerance)
+                 && close(orientations[i], expected_orientations[i], tolerance);
+    }
+    if (ok)
+        return true;
+
+    Histo histo(L, &h[0]);
+    fprintf(stderr, "mismatch : L=%d M=%.9g epsilon=%g histogram=%s\n", L, histo.get_M(), epsilon, kind);
+    print_modes(name, modes, orientations);
+    print_modes("reference", expected, expected_orientations);
+    fprintf(stderr, "  bins :");
+    for (int i(0); i < L; i++)
+        fprintf(stderr, " %.9g", h[i]);
+    fprintf(stderr, "\n");
+    return false;
+}
+
+
+int main(int c, char *v[])
+{
+    double soak(0), tolerance(1e-4);
+    bool seeded(false), verbose(false);
+    Random rnd;
+    rnd.state = 1;
+    int opt;
+    while ((opt = getopt(c, v, "s:r:t:v")) != -1) {
+        switch (opt) {
+        case 's':
+            soak = atof(optarg);
+            break;
+        case 'r':
+            rnd.state = strtoull(optarg, NULL, 10);
+            seeded = true;
+            break;
+        case 't':
+            tolerance = atof(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s seconds] [-r seed] [-t tolerance] [-v]\n", v[0]);
+            return 1;
+        }
+    }
+    if (soak > 0 && !seeded)
+        rnd.state = time(NULL);
+    unsigned long long seed = rnd.state;
+
+    long cases(0), mismatches(0);
+    vector<float> h;
+    double t0 = now();
+    if (soak <= 0) {
+        // Every kind of histogram for L up to 64, and one per L up to 360,
+        // with all the sizes in turn
+        for (int L(1); L <= MAX_L && mismatches < MAX_REPORTS; L++) {
+            int k0 = L <= 64 ? 0 : (L * 7) % N_KINDS;
+            int k1 = L <= 64 ? N_KINDS : k0 + 1;
+            for (int kind(k0); kind < k1 && mismatches < MAX_REPORTS; kind++) {
+                double M = sizes[(L + kind) % N_SIZES];
+                float epsilon = epsilons[(L + kind) % 3];
+                make_histo(rnd, L, M < 0 ? L : M, kind, h);
+                mismatches += !check(h, epsilon, kinds[kind], tolerance);
+                cases++;
+            }
+            if (verbose)
+                fprintf(stderr, "L=%d : %ld cases\n", L, cases);
+        }
+    } else {
+        while (now() - t0 < soak && mismatches < MAX_REPORTS) {
+            int L = 1 + rnd.integer(MAX_L);
+            int kind = rnd.integer(N_KINDS);
+            // M uniform in logarithm up to 10^7, or one of the sizes
+            double M = rnd.uniform() < 0.5 ? floor(pow(10., 7 * rnd.uniform())) : sizes[rnd.integer(N_SIZES)];
+            float epsilon = epsilons[rnd.integer(3)];
+            make_histo(rnd, L, M < 0 ? L : M, kind, h);
+            mismatches += !check(h, epsilon, kinds[kind], tolerance);
+            cases++;
+            if (verbose && cases % 1000 == 0)
+                fprintf(stderr, "%ld cases\n", cases);
+        }
+    }
+
+    printf("%ld cases, %ld mismatches, seed %llu, %.1f s\n", cases, mismatches, seed, now() - t0);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,1129 @@
+/*
+ * Copyright (c) 2010, Nicolas Limare <nicolas.limare@cmla.ens-cachan.fr>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and
+ * documentation are those of the authors and should not be
+ * interpreted as representing official policies, either expressed
+ * or implied, of the copyright holder.
+ */
+
+/**
+ * @mainpage image read/write simplified interface
+ *
+ * README.txt:
+ * @verbinclude README.txt
+ */
+
+/**
+ * @file io_png.cpp
+ * @brief PNG read/write simplified interface
+ *
+ * This is a front-end to libpng, with routines to:
+ * @li read a PNG file as a deinterlaced 8bit integer or float array
+ * @li write a 8bit integer or float array to a PNG file
+ *
+ * Multi-channel images are handled : grey, grey+alpha, rgb and
+ * rgb+alpha, as well as on-the-fly color model conversion.
+ *
+ * @todo handle lossless 16bit data
+ * @todo add a test suite
+ * @todo internally handle RGB/gray conversion in read_png_raw()
+ * @todo handle deinterlacing as a libpng transform function
+ *
+ * @author Nicolas Limare <nicolas.limare@cmla.ens-cachan.fr>
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+#include <string.h>
+
+#include <png.h>
+
+/* ensure consistency */
+#include "io_png.h"
+
+#define PNG_SIG_LEN 4
+
+/* internal only datatype identifiers */
+#define IO_PNG_U8  0x0001       /* 8bit unsigned integer */
+#define IO_PNG_F32 0x0002       /* 32bit float */
+
+/*
+ * ERRORS
+ */
+
+/**
+ * @brief libpng error handler
+ *
+ * The message is written with a single call, not to be mixed with the
+ * messages of other threads, then the control returns to the setjmp()
+ * of the png_struct being used. The jump buffer is stored in this
+ * png_struct, hence the readers and writers can run concurrently on
+ * different files; the local variables modified after setjmp() are
+ * volatile.
+ */
+static void io_png_error(png_structp png_ptr, png_const_charp msg)
+{
+    fprintf(stderr, "libpng error: %s\n", msg);
+    png_longjmp(png_ptr, 1);
+}
+
+/**
+ * @brief libpng warning handler, see io_png_error()
+ */
+static void io_png_warning(png_structp png_ptr, png_const_charp msg)
+{
+    (void) png_ptr;
+    fprintf(stderr, "libpng warning: %s\n", msg);
+}
+
+/*
+ * READ
+ */
+
+/**
+ * @brief internal function used to cleanup the memory when
+ * png_read_raw() fails
+ *
+ * @param fp file pointer to close, ignored if NULL
+ * @param png_ptr_p, info_ptr_p, pointers to PNG structure pointers,
+ *        ignored if NULL
+ * @return NULL
+ */
+static void *read_png_abort(FILE * fp,
+                            png_structp * png_ptr_p, png_infop * info_ptr_p)
+{
+    png_destroy_read_struct(png_ptr_p, info_ptr_p, NULL);
+    if (NULL != fp && stdin != fp)
+        (void) fclose(fp);
+    return NULL;
+}
+
+/**
+ * @brief internal function used to read a PNG file into an array
+ *
+ * @todo don't loose 16bit info
+ *
+ * @param fname PNG file name, "-" means stdin
+ * @param nx, ny, nc pointers to variables to be filled
+ *        with the number of columns, lines and channels of the image
+ * @param transform a PNG_TRANSFORM to be added to the default read transforms
+ * @param dtype identifier for the data type to be used for output
+ * @return pointer to an allocated array of pixels,
+ *         or NULL if an error happens
+ */
+static void *read_png_raw(const char *fname,
+                          size_t * nx, size_t * ny, size_t * nc,
+                          int transform, int dtype)
+{
+    png_byte png_sig[PNG_SIG_LEN];
+    png_structp png_ptr;
+    png_infop info_ptr;
+    png_bytepp row_pointers;
+    png_bytep row_ptr;
+    /* volatile : because of setjmp/longjmp */
+    FILE *volatile fp = NULL;
+    void *data = NULL;
+    unsigned char *data_u8 = NULL;
+    unsigned char *data_u8_ptr = NULL;
+    float *data_f32 = NULL;
+    float *data_f32_ptr = NULL;
+    size_t size;
+    size_t i, j, k;
+
+    /* parameters check */
+    if (NULL == fname || NULL == nx || NULL == ny || NULL == nc)
+        return NULL;
+    if (IO_PNG_U8 != dtype && IO_PNG_F32 != dtype)
+        return NULL;
+
+    /*
+     * set the read filter transforms, to get 8bit RGB whatever the
+     * original file may contain:
+     * PNG_TRANSFORM_STRIP_16      strip 16-bit samples to 8 bits
+     * PNG_TRANSFORM_PACKING       expand 1, 2 and 4-bit
+     *                             samples to bytes
+     */
+    transform |= (PNG_TRANSFORM_STRIP_16 | PNG_TRANSFORM_PACKING);
+
+    /* open the PNG input file */
+    if (0 == strcmp(fname, "-"))
+        fp = stdin;
+    else if (NULL == (fp = fopen(fname, "rb")))
+        return NULL;
+
+    /* read in some of the signature bytes and check this signature */
+    if ((PNG_SIG_LEN != fread(png_sig, 1, PNG_SIG_LEN, fp))
+        || 0 != png_sig_cmp(png_sig, (png_size_t) 0, PNG_SIG_LEN))
+        return read_png_abort(fp, NULL, NULL);
+
+    /*
+     * create and initialize the png_struct
+     * with the error handling of io_png_error()
+     */
+    if (NULL == (png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                                  NULL, io_png_error,
+                                                  io_png_warning)))
+        return read_png_abort(fp, NULL, NULL);
+
+    /* allocate/initialize the memory for image information */
+    if (NULL == (info_ptr = png_create_info_struct(png_ptr)))
+        return read_png_abort(fp, &png_ptr, NULL);
+
+    /* set error handling */
+    if (0 != setjmp(png_jmpbuf(png_ptr)))
+        /* if we get here, we had a problem reading the file */
+        /* free all of the memory associated with the png_ptr and info_ptr */
+        return read_png_abort(fp, &png_ptr, &info_ptr);
+
+    /* set up the input control using standard C streams */
+    png_init_io(png_ptr, fp);
+
+    /* let libpng know that some bytes have been read */
+    png_set_sig_bytes(png_ptr, PNG_SIG_LEN);
+
+    /* read in the entire image at once */
+    png_read_png(png_ptr, info_ptr, transform, NULL);
+
+    /* get image informations */
+    *nx = (size_t) png_get_image_width(png_ptr, info_ptr);
+    *ny = (size_t) png_get_image_height(png_ptr, info_ptr);
+    *nc = (size_t) png_get_channels(png_ptr, info_ptr);
+    row_pointers = png_get_rows(png_ptr, info_ptr);
+
+    /*
+     * allocate the output data RGB array
+     * deinterlace and convert png RGB RGB RGB 8bit to RRR GGG BBB
+     * the image is deinterlaced layer after layer
+     * this generic loop also works for one single channel
+     */
+    size = *nx * *ny * *nc;
+    switch (dtype)
+    {
+    case IO_PNG_U8:
+        if (NULL == (data_u8 =
+                     (unsigned char *) malloc(size * sizeof(unsigned char))))
+            return read_png_abort(fp, &png_ptr, &info_ptr);
+        data = (void *) data_u8;
+        for (k = 0; k < *nc; k++)
+        {
+            /* channel loop */
+            data_u8_ptr = data_u8 + (size_t) (*nx * *ny * k);
+            for (j = 0; j < *ny; j++)
+            {
+                /* row loop */
+                row_ptr = row_pointers[j] + k;
+                for (i = 0; i < *nx; i++)
+                {
+                    /* pixel loop */
+                    *data_u8_ptr++ = (unsigned char) *row_ptr;
+                    row_ptr += *nc;
+                }
+            }
+        }
+        break;
+    case IO_PNG_F32:
+        if (NULL == (data_f32 = (float *) malloc(size * sizeof(float))))
+            return read_png_abort(fp, &png_ptr, &info_ptr);
+        data = (void *) data_f32;
+        for (k = 0; k < *nc; k++)
+        {
+            /* channel loop */
+            data_f32_ptr = data_f32 + (size_t) (*nx * *ny * k);
+            for (j = 0; j < *ny; j++)
+            {
+                /* row loop */
+                row_ptr = row_pointers[j] + k;
+                for (i = 0; i < *nx; i++)
+                {
+                    /* pixel loop */
+                    *data_f32_ptr++ = (float) *row_ptr;
+                    row_ptr += *nc;
+                }
+            }
+        }
+        break;
+    }
+
+    /* clean up and free any memory allocated, close the file */
+    (void) read_png_abort(fp, &png_ptr, &info_ptr);
+
+    return data;
+}
+
+/**
+ * @brief read a PNG file into a 8bit integer array
+ *
+ * The array contains the deinterlaced channels.
+ * 1, 2 and 4bit images are converted to 8bit.
+ * 16bit images are previously downscaled to 8bit.
+ *
+ * @todo don't downscale 16bit images.
+ *
+ * @param fname PNG file name
+ * @param nx, ny, nc pointers to variables to be filled with the number of
+ *        columns, lines and channels of the image
+ * @return pointer to an allocated unsigned char array of pixels,
+ *         or NULL if an error happens
+ */
+unsigned char *read_png_u8(const char *fname,
+                           size_t * nx, size_t * ny, size_t * nc)
+{
+    /* read the image as unsigned char */
+    return (unsigned char *) read_png_raw(fname, nx, ny, nc,
+                                          PNG_TRANSFORM_IDENTITY, IO_PNG_U8);
+}
+
+/**
+ * @brief read a PNG file into a 8bit integer array, converted to RGB
+ *
+ * See read_png_u8() for details.
+ */
+unsigned char *read_png_u8_rgb(const char *fname, size_t * nx, size_t * ny)
+{
+    size_t nc;
+
+    /* read the image as RGB unsigned char */
+    return (unsigned char *) read_png_raw(fname, nx, ny, &nc,
+                                          PNG_TRANSFORM_GRAY_TO_RGB
+                                          | PNG_TRANSFORM_STRIP_ALPHA,
+                                          IO_PNG_U8);
+}
+
+/**
+ * @brief read a PNG file into a 8bit integer array, converted to gray
+ *
+ * See read_png_u8() for details.
+ */
+unsigned char *read_png_u8_gray(const char *fname, size_t * nx, size_t * ny)
+{
+    /* decode and convert the rows one by one, into the final gray array */
+    return read_png_u8_gray_rows(fname, nx, ny, 0, (size_t) -1);
+}
+
+/**
+ * @brief read a PNG file into a 32bit float array
+ *
+ * The array contains the deinterlaced channels.
+ * 1, 2, 4 and 8bit images are converted to float values
+ * between 0. and 1., 3., 15. or 255.
+ * 16bit images are also downscaled to 8bit before conversion.
+ *
+ * @param fname PNG file name
+ * @param nx, ny, nc pointers to variables to be filled with the number of
+ *        columns, lines and channels of the image
+ * @return pointer to an allocated unsigned char array of pixels,
+ *         or NULL if an error happens
+ */
+float *read_png_f32(const char *fname, size_t * nx, size_t * ny, size_t * nc)
+{
+    /* read the image as float */
+    return (float *) read_png_raw(fname, nx, ny, nc,
+                                  PNG_TRANSFORM_IDENTITY, IO_PNG_F32);
+}
+
+/**
+ * @brief read a PNG file into a 32bit float array, converted to RGB
+ *
+ * See read_png_f32() for details.
+ */
+float *read_png_f32_rgb(const char *fname, size_t * nx, size_t * ny)
+{
+    size_t nc;
+
+    /* read the image as RGB float */
+    return (float *) read_png_raw(fname, nx, ny, &nc,
+                                  PNG_TRANSFORM_GRAY_TO_RGB
+                                  | PNG_TRANSFORM_STRIP_ALPHA, IO_PNG_F32);
+}
+
+/**
+ * @brief read a PNG file into a 32bit float array, converted to gray
+ *
+ * See read_png_f32() for details.
+ */
+float *read_png_f32_gray(const char *fname, size_t * nx, size_t * ny)
+{
+    /* decode and convert the rows one by one, into the final gray array */
+    return read_png_f32_gray_rows(fname, nx, ny, 0, (size_t) -1);
+}
+
+/* RGB->gray converters set by io_png_set_gray_converters(), or NULL */
+static io_png_gray_f32_fn gray_converter_f32 = NULL;
+static io_png_gray_u8_fn gray_converter_u8 = NULL;
+
+/**
+ * @brief set the converters of the RGB rows to gray
+ *
+ * They are used for all the RGB images read afterwards, by every thread;
+ * NULL restores the portable conversion.
+ */
+void io_png_set_gray_converters(io_png_gray_f32_fn f32, io_png_gray_u8_fn u8)
+{
+    gray_converter_f32 = f32;
+    gray_converter_u8 = u8;
+}
+
+/**
+ * @brief internal function used to convert a decoded 8bit PNG row
+ * (gray or interleaved RGB) into a gray float row
+ *
+ * The values are exactly the ones of the planar conversion
+ * Y = (float) (6969 * R + 23434 * G + 2365 * B) / 32768
+ * since every intermediate result is an integer smaller than 2^24,
+ * and the division by 32768 is a multiplication by a power of two.
+ *
+ * @param row decoded row of nx pixels with nc channels (1 or 3)
+ * @param out output array of nx floats
+ */
+static void gray_row_f32(const png_byte * row, size_t nx, size_t nc,
+                         float *out)
+{
+    size_t i = 0;
+
+    if (1 == nc)
+    {
+        for (i = 0; i < nx; i++)
+            out[i] = (float) row[i];
+        return;
+    }
+    if (NULL != gray_converter_f32)
+    {
+        gray_converter_f32(row, nx, out);
+        return;
+    }
+
+    /*
+     * RGB->gray conversion
+     * Y = (6969 * R + 23434 * G + 2365 * B)/32768
+     * integer approximation of
+     * Y = 0.212671 * R + 0.715160 * G + 0.072169 * B
+     */
+    for (; i < nx; i++)
+        out[i] = (float) (6969 * row[3 * i] + 23434 * row[3 * i + 1]
+                          + 2365 * row[3 * i + 2]) / 32768;
+}
+
+/**
+ * @brief internal function used to convert a decoded 8bit PNG row
+ * (gray or interleaved RGB) into a gray 8bit row
+ *
+ * Same conversion as gray_row_f32(), rounded down to an integer.
+ */
+static void gray_row_u8(const png_byte * row, size_t nx, size_t nc,
+                        unsigned char *out)
+{
+    size_t i;
+
+    if (1 == nc)
+        memcpy(out, row, nx);
+    else if (NULL != gray_converter_u8)
+        gray_converter_u8(row, nx, out);
+    else
+        for (i = 0; i < nx; i++)
+            out[i] = (unsigned char) ((6969 * row[3 * i] + 23434 * row[3 * i + 1]
+                                       + 2365 * row[3 * i + 2]) / 32768);
+}
+
+/**
+ * @brief internal function used to get a buffer of at least size bytes
+ *
+ * The buffer *buf of *buf_size bytes is replaced by a larger one,
+ * aligned on IO_PNG_ALIGN bytes, if it is too small; its content is
+ * not kept.
+ *
+ * @return the buffer, or NULL if the allocation fails
+ */
+static void *grow_buffer(void **buf, size_t * buf_size, size_t size)
+{
+    void *p;
+
+    if (NULL != *buf && *buf_size >= size)
+        return *buf;
+    if (0 != posix_memalign(&p, IO_PNG_ALIGN, size))
+        return NULL;
+    free(*buf);
+    *buf = p;
+    *buf_size = size;
+    return p;
+}
+
+/**
+ * @brief internal function used to read a band of rows of a PNG file
+ * into an array, converted to gray
+ *
+ * The image is decoded row by row, each row being converted to gray
+ * as soon as it is decoded, and only the rows y0 to y1-1 are kept.
+ * The decoding stops after the row y1-1. Interlaced images can not be
+ * decoded row by row, and are fully decoded as 8bit integers before
+ * the conversion of the band.
+ *
+ * The band is written in out, if it is not NULL, with lines of stride
+ * pixels, else in the data buffer of bufs, if it is not NULL, else in
+ * a newly allocated array; the lines are then nx pixels long. The row
+ * buffer of bufs is used if bufs is not NULL.
+ *
+ * See gray_row_f32() for the conversion details.
+ *
+ * @param fname PNG file name, "-" means stdin
+ * @param nx, ny pointers to variables to be filled with the number of
+ *        columns and lines of the whole image
+ * @param y0, y1 first line of the band, and line after the last one;
+ *        y1 is bounded by the number of lines of the image
+ * @param dtype identifier for the data type to be used for output
+ * @param bufs buffers reused between images, or NULL
+ * @param out, stride, capacity caller array of capacity pixels, or NULL
+ * @return pointer to the (y1-y0) lines of the band, the first line
+ *         being the line y0 of the image, or NULL if an error happens
+ *         or if out is too small
+ */
+static void *read_png_gray_rows(const char *fname, size_t * nx, size_t * ny,
+                                size_t y0, size_t y1, int dtype,
+                                io_png_buffers * bufs,
+                                void *out, size_t stride, size_t capacity)
+{
+    png_byte png_sig[PNG_SIG_LEN];
+    png_structp png_ptr;
+    png_infop info_ptr;
+    /* volatile : because of setjmp/longjmp */
+    FILE *volatile fp = NULL;
+    png_bytep volatile row = NULL;
+    void *volatile data = NULL;
+    png_bytep row_ptr;
+    size_t rowbytes, nc, npass, size, nrows, step;
+    size_t i, j, jmin, jmax, jend;
+    /* the arrays to free on errors */
+    const int own_row = (NULL == bufs);
+    const int own_data = (NULL == out && NULL == bufs);
+
+    /* parameters check */
+    if (NULL == fname || NULL == nx || NULL == ny)
+        return NULL;
+    if (IO_PNG_U8 != dtype && IO_PNG_F32 != dtype)
+        return NULL;
+
+    /* open the PNG input file */
+    if (0 == strcmp(fname, "-"))
+        fp = stdin;
+    else if (NULL == (fp = fopen(fname, "rb")))
+        return NULL;
+
+    /* read in some of the signature bytes and check this signature */
+    if ((PNG_SIG_LEN != fread(png_sig, 1, PNG_SIG_LEN, fp))
+        || 0 != png_sig_cmp(png_sig, (png_size_t) 0, PNG_SIG_LEN))
+        return read_png_abort(fp, NULL, NULL);
+
+    /* create and initialize the png_struct and the image information */
+    if (NULL == (png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                                  NULL, io_png_error,
+                                                  io_png_warning)))
+        return read_png_abort(fp, NULL, NULL);
+    if (NULL == (info_ptr = png_create_info_struct(png_ptr)))
+        return read_png_abort(fp, &png_ptr, NULL);
+
+    /* set error handling */
+    if (0 != setjmp(png_jmpbuf(png_ptr)))
+    {
+        /* if we get here, we had a problem reading the file */
+        if (own_row)
+            free(row);
+        if (own_data)
+            free(data);
+        return read_png_abort(fp, &png_ptr, &info_ptr);
+    }
+
+    png_init_io(png_ptr, fp);
+    png_set_sig_bytes(png_ptr, PNG_SIG_LEN);
+    png_read_info(png_ptr, info_ptr);
+
+    /* same transforms as read_png_raw() for gray images */
+    png_set_strip_16(png_ptr);
+    png_set_packing(png_ptr);
+    png_set_strip_alpha(png_ptr);
+    npass = (size_t) png_set_interlace_handling(png_ptr);
+    png_read_update_info(png_ptr, info_ptr);
+
+    *nx = (size_t) png_get_image_width(png_ptr, info_ptr);
+    *ny = (size_t) png_get_image_height(png_ptr, info_ptr);
+    nc = (size_t) png_get_channels(png_ptr, info_ptr);
+    rowbytes = (size_t) png_get_rowbytes(png_ptr, info_ptr);
+    /* bounded band [jmin, jmax) */
+    jmax = (y1 < *ny ? y1 : *ny);
+    jmin = (y0 < jmax ? y0 : jmax);
+    nrows = jmax - jmin;
+
+    /* the output band, at least one value to get a valid pointer */
+    size = (IO_PNG_U8 == dtype ? sizeof(unsigned char) : sizeof(float));
+    if (NULL != out)
+    {
+        if (stride < *nx || (0 < nrows && (nrows - 1) * stride + *nx > capacity))
+            return read_png_abort(fp, &png_ptr, &info_ptr);
+        data = out;
+        step = stride;
+    }
+    else
+    {
+        step = *nx;
+        if (NULL != bufs)
+            data = grow_buffer(&bufs->data, &bufs->data_size,
+                               (nrows * step + 1) * size);
+        else
+            data = malloc((nrows * step + 1) * size);
+        if (NULL == data)
+            return read_png_abort(fp, &png_ptr, &info_ptr);
+    }
+
+    /*
+     * with interlacing, every pass goes over the whole image, the band
+     * only gets its final values after the last pass
+     */
+    jend = (1 == npass ? jmax : *ny);
+    if (NULL != bufs)
+        row = (png_bytep) grow_buffer(&bufs->row, &bufs->row_size,
+                                      (1 == npass ? 1 : jend) * rowbytes);
+    else
+        row = (png_bytep) malloc((1 == npass ? 1 : jend) * rowbytes);
+    if (NULL == row)
+    {
+        if (own_data)
+            free(data);
+        return read_png_abort(fp, &png_ptr, &info_ptr);
+    }
+    for (i = 1; i < npass; i++)
+        for (j = 0; j < jend; j++)
+            png_read_row(png_ptr, row + j * rowbytes, NULL);
+
+    for (j = 0; j < jend; j++)
+    {
+        /* row loop : decode, and convert the rows of the band */
+        row_ptr = (1 == npass ? row : row + j * rowbytes);
+        png_read_row(png_ptr, row_ptr, NULL);
+        if (j < jmin || j >= jmax)
+            continue;
+        if (IO_PNG_U8 == dtype)
+            gray_row_u8(row_ptr, *nx, nc, (unsigned char *) data + (j - jmin) * step);
+        else
+            gray_row_f32(row_ptr, *nx, nc, (float *) data + (j - jmin) * step);
+    }
+
+    /* clean up, the rows after the band are never decoded */
+    if (own_row)
+        free(row);
+    (void) read_png_abort(fp, &png_ptr, &info_ptr);
+    return data;
+}
+
+/**
+ * @brief read a band of rows of a PNG file into a 32bit float array,
+ * converted to gray
+ *
+ * See read_png_gray_rows() for details.
+ */
+float *read_png_f32_gray_rows(const char *fname, size_t * nx, size_t * ny,
+                              size_t y0, size_t y1)
+{
+    return (float *) read_png_gray_rows(fname, nx, ny, y0, y1, IO_PNG_F32,
+                                        NULL, NULL, 0, 0);
+}
+
+/**
+ * @brief read a band of rows of a PNG file into a 8bit integer array,
+ * converted to gray
+ *
+ * See read_png_gray_rows() for details.
+ */
+unsigned char *read_png_u8_gray_rows(const char *fname, size_t * nx,
+                                     size_t * ny, size_t y0, size_t y1)
+{
+    return (unsigned char *) read_png_gray_rows(fname, nx, ny, y0, y1,
+                                                IO_PNG_U8, NULL, NULL, 0, 0);
+}
+
+/**
+ * @brief read the size of a PNG file, without decoding it
+ *
+ * Only the signature and the header chunk are read, so that the caller
+ * can allocate the array of the image before decoding it.
+ *
+ * @param fname PNG file name, not stdin
+ * @param nx, ny pointers to variables to be filled with the number of
+ *        columns and lines of the image
+ * @return 0 if everything OK, -1 if an error occured
+ */
+int read_png_size(const char *fname, size_t * nx, size_t * ny)
+{
+    png_byte png_sig[PNG_SIG_LEN];
+    png_structp png_ptr;
+    png_infop info_ptr;
+    FILE *fp;
+
+    /* parameters check */
+    if (NULL == fname || NULL == nx || NULL == ny || 0 == strcmp(fname, "-"))
+        return -1;
+    if (NULL == (fp = fopen(fname, "rb")))
+        return -1;
+    if ((PNG_SIG_LEN != fread(png_sig, 1, PNG_SIG_LEN, fp))
+        || 0 != png_sig_cmp(png_sig, (png_size_t) 0, PNG_SIG_LEN))
+    {
+        (void) read_png_abort(fp, NULL, NULL);
+        return -1;
+    }
+    if (NULL == (png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                                  NULL, io_png_error,
+                                                  io_png_warning)))
+    {
+        (void) read_png_abort(fp, NULL, NULL);
+        return -1;
+    }
+    if (NULL == (info_ptr = png_create_info_struct(png_ptr)))
+    {
+        (void) read_png_abort(fp, &png_ptr, NULL);
+        return -1;
+    }
+    if (0 != setjmp(png_jmpbuf(png_ptr)))
+    {
+        (void) read_png_abort(fp, &png_ptr, &info_ptr);
+        return -1;
+    }
+
+    png_init_io(png_ptr, fp);
+    png_set_sig_bytes(png_ptr, PNG_SIG_LEN);
+    png_read_info(png_ptr, info_ptr);
+    *nx = (size_t) png_get_image_width(png_ptr, info_ptr);
+    *ny = (size_t) png_get_image_height(png_ptr, info_ptr);
+
+    (void) read_png_abort(fp, &png_ptr, &info_ptr);
+    return 0;
+}
+
+/*
+ * READER
+ */
+
+/**
+ * @brief empty reader, the buffers are allocated by the first image
+ */
+PngReader::PngReader()
+{
+    memset(&m_bufs, 0, sizeof(m_bufs));
+}
+
+/**
+ * @brief free the buffers, and the last image read in them
+ */
+PngReader::~PngReader()
+{
+    free(m_bufs.data);
+    free(m_bufs.row);
+    free(m_bufs.file_buffer);
+}
+
+/**
+ * @brief read a band of rows of a PNG file into the buffer of the
+ * reader, as a 32bit float gray array
+ *
+ * The buffer is only reallocated when it is too small for the image.
+ * See read_png_gray_rows() for details.
+ *
+ * @return pointer to the band, valid until the next read, or NULL
+ */
+float *PngReader::read_f32_gray(const char *fname, size_t * nx, size_t * ny,
+                                size_t y0, size_t y1)
+{
+    return (float *) read_png_gray_rows(fname, nx, ny, y0, y1, IO_PNG_F32,
+                                        &m_bufs, NULL, 0, 0);
+}
+
+/**
+ * @brief same as PngReader::read_f32_gray(), as a 8bit integer array
+ */
+unsigned char *PngReader::read_u8_gray(const char *fname, size_t * nx,
+                                       size_t * ny, size_t y0, size_t y1)
+{
+    return (unsigned char *) read_png_gray_rows(fname, nx, ny, y0, y1,
+                                                IO_PNG_U8, &m_bufs, NULL,
+                                                0, 0);
+}
+
+/**
+ * @brief read a band of rows of a PNG file into the caller array out,
+ * as a 32bit float gray array
+ *
+ * @param out, stride, capacity array of capacity floats, receiving
+ *        lines of stride floats
+ * @return 0 if everything OK, -1 if an error occured or if out is too
+ *         small for the band
+ */
+int PngReader::read_f32_gray(const char *fname, size_t * nx, size_t * ny,
+                             size_t y0, size_t y1,
+                             float *out, size_t stride, size_t capacity)
+{
+    if (NULL == out)
+        return -1;
+    return (NULL == read_png_gray_rows(fname, nx, ny, y0, y1, IO_PNG_F32,
+                                       &m_bufs, out, stride, capacity)
+            ? -1 : 0);
+}
+
+/**
+ * @brief same as PngReader::read_f32_gray(), as a 8bit integer array
+ */
+int PngReader::read_u8_gray(const char *fname, size_t * nx, size_t * ny,
+                            size_t y0, size_t y1,
+                            unsigned char *out, size_t stride, size_t capacity)
+{
+    if (NULL == out)
+        return -1;
+    return (NULL == read_png_gray_rows(fname, nx, ny, y0, y1, IO_PNG_U8,
+                                       &m_bufs, out, stride, capacity)
+            ? -1 : 0);
+}
+
+/*
+ * WRITE
+ */
+
+/**
+ * @brief internal function used to cleanup the memory when
+ * png_write_raw() fails
+ *
+ * @param fp file pointer to close, ignored if NULL
+ * @param row row buffer to free, ignored if NULL
+ * @param png_ptr_p, info_ptr_p, pointers to PNG structure pointers,
+ *        ignored if NULL
+ * @return -1
+ */
+static int write_png_abort(FILE * fp, png_byte * row,
+                           png_structp * png_ptr_p, png_infop * info_ptr_p)
+{
+    png_destroy_write_struct(png_ptr_p, info_ptr_p);
+    if (NULL != row)
+        free(row);
+    if (NULL != fp && stdout != fp)
+        (void) fclose(fp);
+    return -1;
+}
+
+/**
+ * @brief internal function used to interlace the channels of a line
+ *
+ * The line j of the nc channels, each one made of ny lines of stride
+ * values, is converted to a RGB RGB RGB 8bit row. The float values are
+ * rounded and bounded to [0, 255].
+ */
+static void interlace_row(const void *data, size_t nx, size_t ny,
+                          size_t nc, size_t stride, size_t j, int dtype,
+                          png_byte * row)
+{
+    const unsigned char *data_u8;
+    const float *data_f32;
+    float tmp;
+    size_t i, k;
+
+    for (k = 0; k < nc; k++)
+    {
+        /* channel loop */
+        if (IO_PNG_U8 == dtype)
+        {
+            data_u8 = (const unsigned char *) data + (k * ny + j) * stride;
+            for (i = 0; i < nx; i++)
+                row[i * nc + k] = (png_byte) data_u8[i];
+        }
+        else
+        {
+            data_f32 = (const float *) data + (k * ny + j) * stride;
+            for (i = 0; i < nx; i++)
+            {
+                tmp = floor(data_f32[i] + .5);
+                row[i * nc + k] = (png_byte) (tmp < 0. ? 0. :
+                                              (tmp > 255. ? 255. : tmp));
+            }
+        }
+    }
+}
+
+/**
+ * @brief internal function used to write a byte array as a PNG file
+ *
+ * The PNG file is written as a 8bit image file, truecolor, row by
+ * row. Depending on the number of channels, the color model is gray,
+ * gray+alpha, rgb, rgb+alpha.
+ *
+ * @todo handle 16bit
+ *
+ * @param fname PNG file name, "-" means stdout
+ * @param data deinterlaced (RRR..GGG..BBB..AAA) image array, each
+ *        channel being made of ny lines of stride values
+ * @param nx, ny, nc number of columns, lines and channels
+ * @param stride distance between two lines, in values
+ * @param dtype identifier for the data type to be used for output
+ * @param opt compression level, filters and interlacing
+ * @param bufs row and file buffers reused between images, or NULL
+ * @return 0 if everything OK, -1 if an error occured
+ */
+static int write_png_raw(const char *fname, const void *data,
+                         size_t nx, size_t ny, size_t nc, size_t stride,
+                         int dtype, const io_png_options * opt,
+                         io_png_buffers * bufs)
+{
+    png_structp png_ptr;
+    png_infop info_ptr;
+    /* volatile : because of setjmp/longjmp */
+    FILE *volatile fp;
+    png_bytep volatile row = NULL;
+    /* the row to free on errors */
+    const int own_row = (NULL == bufs);
+    int color_type, npass, p;
+    size_t j;
+
+    /* parameters check */
+    if (0 >= nx || 0 >= ny || 0 >= nc || stride < nx)
+        return -1;
+    if (NULL == fname || NULL == data || NULL == opt)
+        return -1;
+    if (IO_PNG_U8 != dtype && IO_PNG_F32 != dtype)
+        return -1;
+
+    /* color model */
+    switch (nc)
+    {
+    case 1:
+        color_type = PNG_COLOR_TYPE_GRAY;
+        break;
+    case 2:
+        color_type = PNG_COLOR_TYPE_GRAY_ALPHA;
+        break;
+    case 3:
+        color_type = PNG_COLOR_TYPE_RGB;
+        break;
+    case 4:
+        color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+        break;
+    default:
+        return -1;
+    }
+
+    /* open the PNG output file, with a large buffer for the writes */
+    if (0 == strcmp(fname, "-"))
+        fp = stdout;
+    else if (NULL == (fp = fopen(fname, "wb")))
+        return -1;
+    if (NULL != bufs && stdout != fp
+        && NULL != grow_buffer(&bufs->file_buffer, &bufs->file_buffer_size,
+                               IO_PNG_FILE_BUFFER))
+        (void) setvbuf(fp, (char *) bufs->file_buffer, _IOFBF,
+                       IO_PNG_FILE_BUFFER);
+
+    /* allocate the interlaced row */
+    if (NULL != bufs)
+        row = (png_bytep) grow_buffer(&bufs->row, &bufs->row_size, nx * nc);
+    else
+        row = (png_bytep) malloc(nx * nc);
+    if (NULL == row)
+        return write_png_abort(fp, NULL, NULL, NULL);
+
+    /*
+     * create and initialize the png_struct
+     * with the error handling of io_png_error()
+     */
+    if (NULL == (png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+                                                   NULL, io_png_error,
+                                                   io_png_warning)))
+        return write_png_abort(fp, own_row ? row : NULL, NULL, NULL);
+
+    /* allocate/initialize the memory for image information */
+    if (NULL == (info_ptr = png_create_info_struct(png_ptr)))
+        return write_png_abort(fp, own_row ? row : NULL, &png_ptr, NULL);
+
+    /* set error handling */
+    if (0 != setjmp(png_jmpbuf(png_ptr)))
+        /* if we get here, we had a problem writing the file */
+        return write_png_abort(fp, own_row ? row : NULL,
+                               &png_ptr, &info_ptr);
+
+    /* set up the output control using standard C streams */
+    png_init_io(png_ptr, fp);
+
+    /* compression settings */
+    if (opt->level >= 0)
+        png_set_compression_level(png_ptr, opt->level);
+    if (opt->filters >= 0)
+        png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, opt->filters);
+
+    /* set image header */
+    png_set_IHDR(png_ptr, info_ptr, (png_uint_32) nx, (png_uint_32) ny, 8,
+                 color_type, (opt->interlace ? PNG_INTERLACE_ADAM7
+                              : PNG_INTERLACE_NONE),
+                 PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+    /* TODO : significant bit (sBIT), gamma (gAMA), comments (text) chunks */
+    png_write_info(png_ptr, info_ptr);
+
+    /*
+     * interlace and convert RRR GGG BBB to RGB RGB RGB, row by row;
+     * with ADAM7 interlacing, every pass goes over all the rows
+     */
+    npass = png_set_interlace_handling(png_ptr);
+    for (p = 0; p < npass; p++)
+        for (j = 0; j < ny; j++)
+        {
+            interlace_row(data, nx, ny, nc, stride, j, dtype, row);
+            png_write_row(png_ptr, row);
+        }
+    png_write_end(png_ptr, info_ptr);
+
+    /* clean up and free any memory allocated, close the file */
+    if (stdout != fp && 0 != fclose(fp))
+    {
+        fp = NULL;
+        return write_png_abort(NULL, own_row ? row : NULL,
+                               &png_ptr, &info_ptr);
+    }
+    (void) write_png_abort(NULL, own_row ? row : NULL, &png_ptr, &info_ptr);
+
+    return 0;
+}
+
+/**
+ * @brief write a 8bit unsigned integer array into a PNG file
+ *
+ * The image is interlaced (ADAM7), with the default compression.
+ *
+ * @param fname PNG file name
+ * @param data array to write
+ * @param nx, ny, nc number of columns, lines and channels of the image
+ * @return 0 if everything OK, -1 if an error occured
+ */
+int write_png_u8(const char *fname, const unsigned char *data,
+                 size_t nx, size_t ny, size_t nc)
+{
+    io_png_options opt = { -1, -1, 1 };
+
+    return write_png_raw(fname, data, nx, ny, nc, nx, IO_PNG_U8, &opt, NULL);
+}
+
+/**
+ * @brief write a float array into a PNG file
+ *
+ * The float values are rounded to 8bit integers, and bounded to [0, 255].
+ * The image is interlaced (ADAM7), with the default compression.
+ *
+ * @todo handle 16bit images and flexible min/max
+ *
+ * @param fname PNG file name
+ * @param data array to write
+ * @param nx, ny, nc number of columns, lines and channels of the image
+ * @return 0 if everything OK, -1 if an error occured
+ */
+int write_png_f32(const char *fname, const float *data,
+                  size_t nx, size_t ny, size_t nc)
+{
+    io_png_options opt = { -1, -1, 1 };
+
+    return write_png_raw(fname, data, nx, ny, nc, nx, IO_PNG_F32, &opt, NULL);
+}
+
+/*
+ * WRITER
+ */
+
+/**
+ * @brief writer with the default settings : default compression level
+ * and filters of libpng, no interlacing
+ */
+PngWriter::PngWriter()
+{
+    memset(&m_bufs, 0, sizeof(m_bufs));
+    m_opt.level = -1;
+    m_opt.filters = -1;
+    m_opt.interlace = 0;
+}
+
+/**
+ * @brief free the buffers
+ */
+PngWriter::~PngWriter()
+{
+    free(m_bufs.data);
+    free(m_bufs.row);
+    free(m_bufs.file_buffer);
+}
+
+/**
+ * @brief set the zlib compression level, from 0 (none, fastest) to 9
+ * (best, slowest); -1 restores the default of libpng
+ */
+void PngWriter::set_compression_level(int level)
+{
+    m_opt.level = (level > 9 ? 9 : level);
+}
+
+/**
+ * @brief set the row filters tried by libpng, as a combination of
+ * PNG_FILTER_NONE, PNG_FILTER_SUB... (PNG_FILTER_NONE is the fastest);
+ * -1 restores the default of libpng
+ */
+void PngWriter::set_filters(int filters)
+{
+    m_opt.filters = filters;
+}
+
+/**
+ * @brief write the next images with (ADAM7) or without interlacing
+ */
+void PngWriter::set_interlace(bool interlace)
+{
+    m_opt.interlace = interlace ? 1 : 0;
+}
+
+/**
+ * @brief write a 8bit unsigned integer array into a PNG file
+ *
+ * @param fname PNG file name
+ * @param data array to write, see write_png_raw()
+ * @param nx, ny, nc number of columns, lines and channels of the image
+ * @param stride distance between two lines, nx if 0
+ * @return 0 if everything OK, -1 if an error occured
+ */
+int PngWriter::write_u8(const char *fname, const unsigned char *data,
+                        size_t nx, size_t ny, size_t nc, size_t stride)
+{
+    return write_png_raw(fname, data, nx, ny, nc, (stride ? stride : nx),
+                         IO_PNG_U8, &m_opt, &m_bufs);
+}
+
+/**
+ * @brief write a float array into a PNG file, see PngWriter::write_u8()
+ * and write_png_f32()
+ */
+int PngWriter::write_f32(const char *fname, const float *data,
+                         size_t nx, size_t ny, size_t nc, size_t stride)
+{
+    return write_png_raw(fname, data, nx, ny, nc, (stride ? stride : nx),
+                         IO_PNG_F32, &m_opt, &m_bufs);
+}
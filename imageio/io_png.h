@@ -0,0 +1,100 @@
+#ifndef	IO_PNG_H
+#define IO_PNG_H
+
+#include <stddef.h>
+
+#define IO_PNG_VERSION 0.20100727
+
+/* alignment of the buffers allocated by the readers and writers */
+#define IO_PNG_ALIGN 64
+/* size of the stdio buffer of the files written by PngWriter */
+#define IO_PNG_FILE_BUFFER (1 << 20)
+
+unsigned char *read_png_u8(const char *fname, size_t *nx, size_t *ny, size_t *nc);
+unsigned char *read_png_u8_rgb(const char *fname, size_t *nx, size_t *ny);
+unsigned char *read_png_u8_gray(const char *fname, size_t *nx, size_t *ny);
+unsigned char *read_png_u8_gray_rows(const char *fname, size_t *nx, size_t *ny, size_t y0, size_t y1);
+float *read_png_f32(const char *fname, size_t *nx, size_t *ny, size_t *nc);
+float *read_png_f32_rgb(const char *fname, size_t *nx, size_t *ny);
+float *read_png_f32_gray(const char *fname, size_t *nx, size_t *ny);
+float *read_png_f32_gray_rows(const char *fname, size_t *nx, size_t *ny, size_t y0, size_t y1);
+int read_png_size(const char *fname, size_t *nx, size_t *ny);
+int write_png_u8(const char *fname, const unsigned char *data, size_t nx, size_t ny, size_t nc);
+int write_png_f32(const char *fname, const float *data, size_t nx, size_t ny, size_t nc);
+
+/* converters of a row of nx interleaved RGB pixels to gray, replacing the
+ * portable ones when set (for instance by versions compiled for the
+ * processor); they must give the same values, see gray_row_f32() */
+typedef void (*io_png_gray_f32_fn)(const unsigned char *rgb, size_t nx, float *out);
+typedef void (*io_png_gray_u8_fn)(const unsigned char *rgb, size_t nx, unsigned char *out);
+void io_png_set_gray_converters(io_png_gray_f32_fn f32, io_png_gray_u8_fn u8);
+
+/* buffers kept by the readers and writers between two images */
+struct io_png_buffers {
+    void *data;                 /* decoded image */
+    size_t data_size;
+    void *row;                  /* decoded or interlaced rows */
+    size_t row_size;
+    void *file_buffer;          /* stdio buffer of the output file */
+    size_t file_buffer_size;
+};
+
+/* settings of the writers, -1 for the default of libpng */
+struct io_png_options {
+    int level;                  /* zlib compression level, 0 to 9 */
+    int filters;                /* PNG_FILTER_NONE, PNG_FILTER_SUB... */
+    int interlace;              /* ADAM7 interlacing if not 0 */
+};
+
+/*
+ * Reader of gray images, or bands of rows of gray images, whose buffers
+ * are reused from one image to the next. The image is written either in
+ * the buffer of the reader, valid until the next read, or in an array of
+ * the caller, with its own stride between lines.
+ */
+class PngReader
+{
+public:
+    PngReader();
+    ~PngReader();
+
+    float *read_f32_gray(const char *fname, size_t *nx, size_t *ny, size_t y0 = 0, size_t y1 = (size_t) -1);
+    unsigned char *read_u8_gray(const char *fname, size_t *nx, size_t *ny, size_t y0 = 0, size_t y1 = (size_t) -1);
+    int read_f32_gray(const char *fname, size_t *nx, size_t *ny, size_t y0, size_t y1, float *out, size_t stride, size_t capacity);
+    int read_u8_gray(const char *fname, size_t *nx, size_t *ny, size_t y0, size_t y1, unsigned char *out, size_t stride, size_t capacity);
+
+private:
+    PngReader(const PngReader &);
+    PngReader &operator=(const PngReader &);
+
+    io_png_buffers m_bufs;
+};
+
+/*
+ * Writer of 8bit PNG images from deinterlaced arrays with a stride between
+ * lines (0 for nx), streamed row by row through a reused row buffer. The
+ * compression level and the row filters trade the size of the files for
+ * the time spent to write them.
+ */
+class PngWriter
+{
+public:
+    PngWriter();
+    ~PngWriter();
+
+    void set_compression_level(int level);
+    void set_filters(int filters);
+    void set_interlace(bool interlace);
+
+    int write_u8(const char *fname, const unsigned char *data, size_t nx, size_t ny, size_t nc, size_t stride = 0);
+    int write_f32(const char *fname, const float *data, size_t nx, size_t ny, size_t nc, size_t stride = 0);
+
+private:
+    PngWriter(const PngWriter &);
+    PngWriter &operator=(const PngWriter &);
+
+    io_png_buffers m_bufs;
+    io_png_options m_opt;
+};
+
+#endif